@@ -2,39 +2,52 @@
 #include <cstdio>
 #include <stdlib.h>
 #include "functions.h"
+#include "i8080.h"
+#include "opcodes.h"
+#include "profile.h"
 
-struct ConditionCodes {
-    uint8_t z:1;
-    uint8_t s:1;
-    uint8_t p:1;
-    uint8_t cy:1;
-    uint8_t ac:1;
-    uint8_t pad:3;
-};
+// Set PRINTOPS to 0 to build the core without the per-instruction trace
+// (the benchmarks need this, printf dominates everything otherwise).
+#ifndef PRINTOPS
+#define PRINTOPS 1
+#endif
 
-struct State8080 {
-    uint8_t a;
-    uint8_t b;
-    uint8_t c;
-    uint8_t d;
-    uint8_t e;
-    uint8_t h;
-    uint8_t l;
-    uint16_t sp;
-    uint16_t pc;
-    uint8_t* memory;
-    ConditionCodes cc;
-    uint8_t int_enable;
-};
+// Set PROFILE_OPS to 1 to count executions per opcode and per address
+// into state->profile (see profile.h).
+#ifndef PROFILE_OPS
+#define PROFILE_OPS 0
+#endif
+
+// Set PROFILE_CALLS to 1 to keep a shadow call stack in state->calls and
+// charge cycles and host time to 8080 subroutines (see profile.h).
+#ifndef PROFILE_CALLS
+#define PROFILE_CALLS 0
+#endif
+
+// Set PROFILE_MEMORY to 1 to count data reads and writes per address into
+// state->heatmap (see profile.h).
+#ifndef PROFILE_MEMORY
+#define PROFILE_MEMORY 0
+#endif
 
-void UnimplementedInstruction(State8080* state)
+// All data accesses go through these two. Instruction fetches read
+// memory directly and are counted by the opcode profiler instead.
+static inline uint8_t ReadMem(State8080* state, uint16_t address)
 {
-    // pc will have advanced one, so undo that
-    state->pc -= 1;
-    printf("Error: Unimplemented instruction\n");
-    Disassemble8080Op(state->memory, state->pc);
-    printf("\n");
-    exit(1);
+#if PROFILE_MEMORY
+    if (state->heatmap != NULL)
+        state->heatmap->reads[address]++;
+#endif
+    return state->memory[address];
+}
+
+static inline void WriteMem(State8080* state, uint16_t address, uint8_t value)
+{
+#if PROFILE_MEMORY
+    if (state->heatmap != NULL)
+        state->heatmap->writes[address]++;
+#endif
+    state->memory[address] = value;
 }
 
 int parity(int x, int size)
@@ -50,1242 +63,1091 @@ int parity(int x, int size)
     return (0 == (p & 0x1));
 }
 
-void LogicFlagsA(State8080* state)
+// dead is the set of flags the analysis found are overwritten before
+// anything reads them (see FindDeadFlags), parity being the one worth
+// skipping.
+void ZSPFlags(State8080* state, uint8_t value, uint8_t dead)
+{
+    state->cc.z = (value == 0);
+    state->cc.s = (value & 0x80) == 0x80;
+    if (!(dead & FLAG_P))
+        state->cc.p = parity(value, 8);
+}
+
+// Accumulator arithmetic. The auxiliary carry is the carry out of bit 3,
+// which DAA needs; the 8080 exercisers check it on every ALU op.
+void AddA(State8080* state, uint8_t value, uint8_t carry, uint8_t dead)
+{
+    uint16_t answer = state->a + value + carry;
+    state->cc.ac = ((state->a ^ value ^ answer) & 0x10) == 0x10;
+    state->cc.cy = answer > 0xff;
+    state->a = answer & 0xff;
+    ZSPFlags(state, state->a, dead);
+}
+
+void SubA(State8080* state, uint8_t value, uint8_t borrow, uint8_t dead)
+{
+    // subtraction is addition of the complement, with carry meaning borrow
+    AddA(state, ~value, !borrow, dead);
+    state->cc.cy = !state->cc.cy;
+}
+
+void AndA(State8080* state, uint8_t value, uint8_t dead)
+{
+    state->cc.ac = ((state->a | value) & 0x08) == 0x08;
+    state->cc.cy = 0;
+    state->a &= value;
+    ZSPFlags(state, state->a, dead);
+}
+
+void XorA(State8080* state, uint8_t value, uint8_t dead)
+{
+    state->cc.cy = state->cc.ac = 0;
+    state->a ^= value;
+    ZSPFlags(state, state->a, dead);
+}
+
+void OrA(State8080* state, uint8_t value, uint8_t dead)
 {
     state->cc.cy = state->cc.ac = 0;
-    state->cc.z = (state->a == 0);
-    state->cc.s = (state->a & 0x80) == 0x80;
-    state->cc.p = parity(state->a, 8);
+    state->a |= value;
+    ZSPFlags(state, state->a, dead);
+}
+
+void CmpA(State8080* state, uint8_t value, uint8_t dead)
+{
+    uint16_t answer = state->a - value;
+    state->cc.cy = answer > 0xff;
+    state->cc.ac = (~(state->a ^ answer ^ value) & 0x10) == 0x10;
+    ZSPFlags(state, answer & 0xff, dead);
+}
+
+static inline void Push(State8080* state, uint16_t value)
+{
+    WriteMem(state, state->sp - 1, (value >> 8) & 0xff);
+    WriteMem(state, state->sp - 2, value & 0xff);
+    state->sp = state->sp - 2;
+}
+
+static inline uint16_t Pop(State8080* state)
+{
+    uint16_t value = ReadMem(state, state->sp) | (ReadMem(state, state->sp + 1) << 8);
+    state->sp += 2;
+    return value;
+}
+
+// pc is already past the instruction when these run, so an untaken
+// branch has nothing to do
+static inline void Jump(State8080* state, unsigned char* opcode, int condition)
+{
+    if (condition)
+        state->pc = (opcode[2] << 8) | opcode[1];
+}
+
+// Emulate8080p charges the taken cost up front, untaken conditional calls
+// and returns give the difference back.
+static inline void Call(State8080* state, unsigned char* opcode, int condition)
+{
+    const OpInfo8080* info = &opinfo8080[opcode[0]];
+    if (condition)
+    {
+        Push(state, state->pc);
+        state->pc = (opcode[2] << 8) | opcode[1];
+    }
+    else
+        state->cycles -= info->cycles - info->cycles_not_taken;
+}
+
+static inline void Return(State8080* state, unsigned char* opcode, int condition)
+{
+    const OpInfo8080* info = &opinfo8080[opcode[0]];
+    if (condition)
+        state->pc = Pop(state);
+    else
+        state->cycles -= info->cycles - info->cycles_not_taken;
+}
+
+// Register operands as the opcodes encode them, M being memory at HL
+enum {
+    REG_B, REG_C, REG_D, REG_E, REG_H, REG_L, REG_M, REG_A,
+};
+
+enum {
+    PAIR_BC, PAIR_DE, PAIR_HL, PAIR_SP,
+};
+
+enum {
+    ALU_ADD, ALU_ADC, ALU_SUB, ALU_SBB, ALU_ANA, ALU_XRA, ALU_ORA, ALU_CMP,
+};
+
+// The register families are templates on the register (and operation) so
+// each opcode's case gets its own specialized code; the register is picked
+// at compile time, never from the opcode bits at run time.
+template <int R>
+static inline uint8_t GetReg(State8080* state)
+{
+    if constexpr (R == REG_B) return state->b;
+    else if constexpr (R == REG_C) return state->c;
+    else if constexpr (R == REG_D) return state->d;
+    else if constexpr (R == REG_E) return state->e;
+    else if constexpr (R == REG_H) return state->h;
+    else if constexpr (R == REG_L) return state->l;
+    else if constexpr (R == REG_M) return ReadMem(state, state->hl);
+    else return state->a;
+}
+
+template <int R>
+static inline void SetReg(State8080* state, uint8_t value)
+{
+    if constexpr (R == REG_B) state->b = value;
+    else if constexpr (R == REG_C) state->c = value;
+    else if constexpr (R == REG_D) state->d = value;
+    else if constexpr (R == REG_E) state->e = value;
+    else if constexpr (R == REG_H) state->h = value;
+    else if constexpr (R == REG_L) state->l = value;
+    else if constexpr (R == REG_M) WriteMem(state, state->hl, value);
+    else state->a = value;
+}
+
+template <int RP>
+static inline uint16_t& Pair(State8080* state)
+{
+    if constexpr (RP == PAIR_BC) return state->bc;
+    else if constexpr (RP == PAIR_DE) return state->de;
+    else if constexpr (RP == PAIR_HL) return state->hl;
+    else return state->sp;
+}
+
+template <int D, int S>
+static inline void Mov(State8080* state)
+{
+    SetReg<D>(state, GetReg<S>(state));
+}
+
+template <int OP, int S>
+static inline void Alu(State8080* state, uint8_t dead)
+{
+    uint8_t value = GetReg<S>(state);
+    if constexpr (OP == ALU_ADD) AddA(state, value, 0, dead);
+    else if constexpr (OP == ALU_ADC) AddA(state, value, state->cc.cy, dead);
+    else if constexpr (OP == ALU_SUB) SubA(state, value, 0, dead);
+    else if constexpr (OP == ALU_SBB) SubA(state, value, state->cc.cy, dead);
+    else if constexpr (OP == ALU_ANA) AndA(state, value, dead);
+    else if constexpr (OP == ALU_XRA) XorA(state, value, dead);
+    else if constexpr (OP == ALU_ORA) OrA(state, value, dead);
+    else CmpA(state, value, dead);
+}
+
+// INR and DCR leave carry alone
+template <int R>
+static inline void Inr(State8080* state, uint8_t dead)
+{
+    uint8_t answer = GetReg<R>(state) + 1;
+    state->cc.ac = (answer & 0x0f) == 0;
+    ZSPFlags(state, answer, dead);
+    SetReg<R>(state, answer);
+}
+
+template <int R>
+static inline void Dcr(State8080* state, uint8_t dead)
+{
+    uint8_t answer = GetReg<R>(state) - 1;
+    state->cc.ac = (answer & 0x0f) != 0x0f;
+    ZSPFlags(state, answer, dead);
+    SetReg<R>(state, answer);
+}
+
+template <int R>
+static inline void Mvi(State8080* state, unsigned char* opcode)
+{
+    SetReg<R>(state, opcode[1]);
+}
+
+template <int RP>
+static inline void Lxi(State8080* state, unsigned char* opcode)
+{
+    Pair<RP>(state) = (opcode[2] << 8) | opcode[1];
+}
+
+template <int RP>
+static inline void Inx(State8080* state)
+{
+    Pair<RP>(state)++;
+}
+
+template <int RP>
+static inline void Dcx(State8080* state)
+{
+    Pair<RP>(state)--;
 }
 
-void ArithFlagsA(State8080* state, uint16_t answer16) {
-    state->cc.cy = answer16 > 0xff;
-    state->cc.z = (answer16 & 0xff) == 0;
-    state->cc.s = (answer16 & 0x80) == 0x80;
-    state->cc.p = parity(answer16 & 0xff, 8);
+template <int RP>
+static inline void Dad(State8080* state)
+{
+    uint32_t answer = state->hl + Pair<RP>(state);
+    state->cc.cy = (answer & 0xffff0000) != 0;
+    state->hl = answer & 0xffff;
 }
 
 int Emulate8080p(State8080* state)
 {
-    int cycles = 4;
     unsigned char *opcode = &state->memory[state->pc];
 
+#if PRINTOPS
     Disassemble8080Op(state->memory, state->pc);
-    state->pc += 1;
+#endif
+#if PROFILE_OPS
+    if (state->profile != NULL)
+        ProfileOp(state->profile, state->pc, *opcode);
+#endif
+#if PROFILE_CALLS
+    uint8_t op = *opcode;
+    uint16_t sp_before = state->sp;
+#endif
+    uint8_t dead = 0;
+    if (state->dead_flags != NULL)
+        dead = state->dead_flags[state->pc];
+    const OpInfo8080* info = &opinfo8080[*opcode];
+    state->pc += info->length;
+    state->cycles += info->cycles;
 
-    uint8_t answer8;
-    uint16_t answer16;
-    uint32_t answer32;
     uint16_t offset;
-    uint32_t hl;
-    uint32_t bc;
-    uint32_t de;
 
     switch(*opcode)
     {
         case 0x00: break;                       // NOP 
-        case 0x01:                              // LXI B, word
-            state->c = opcode[1]; 
-            state->b = opcode[2];
-            state->pc += 2;
+        case 0x01:                              // LXI B
+            Lxi<PAIR_BC>(state, opcode);
+            break;
+        case 0x02:                              // STAX B
+            offset = state->bc;
+            WriteMem(state, offset, state->a);
             break;
-        case 0x02: UnimplementedInstruction(state); break;
         case 0x03:                              // INX B
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->b<<8) | (state->c);
-            // state->memory[offset] = (state->memory[offset] + 1) & 0xff;
+            Inx<PAIR_BC>(state);
             break;
         case 0x04:                              // INR B
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->b + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->b = answer & 0xff;
+            Inr<REG_B>(state, dead);
             break;
         case 0x05:                              // DCR B
-            answer8 = state->b - 1; 
-            state->cc.z =  (answer8 == 0);    
-            state->cc.s = ((answer8 & 0x80) == 0x80);    
-            state->cc.p = parity(answer8, 8);
-            state->b = answer8;
+            Dcr<REG_B>(state, dead);
             break;
         case 0x06:                              // MVI B
-            state->b = opcode[1];
-            state->pc += 2;
-            break;
-        case 0x07: UnimplementedInstruction(state); break;
-        case 0x08: UnimplementedInstruction(state); break;
+            Mvi<REG_B>(state, opcode);
+            break;
+        case 0x07:                              // RLC
+            {
+                uint8_t x = state->a;
+                state->a = ((x & 0x80) >> 7) | (x << 1);
+                state->cc.cy = (0x80 == (x & 0x80));
+                break;
+            }
+        case 0x08: break;                       // NOP (undocumented)
         case 0x09:                              // DAD B
-            hl = (state->h<<8) | (state->l);
-            bc = (state->b<<8) | (state->c);
-            answer32 = hl + bc;
-            state->h = (answer32 & 0xff00) >> 8;
-            state->l = answer32 & 0xff;
-            state->cc.cy = (answer32 & 0xffff0000) > 0; 
+            Dad<PAIR_BC>(state);
             break;
         case 0x0a:                              // LDAX B
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->b<<8) | (state->c);
-            // state->a = state->memory[offset];
+            offset = state->bc;
+            state->a = ReadMem(state, offset);
             break;
         case 0x0b:                              // DCX B
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->b<<8) | (state->c);
-            // state->memory[offset] = (state->memory[offset] - 1) & 0xff;
+            Dcx<PAIR_BC>(state);
             break;
         case 0x0c:                              // INR C
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->c + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->c = answer & 0xff;
+            Inr<REG_C>(state, dead);
             break;
         case 0x0d:                              // DCR C
-            answer8 = state->c - 1; 
-            state->cc.z =  (answer8 == 0);    
-            state->cc.s = (answer8 & 0x80) == 0x80;    
-            state->cc.p = parity(answer8, 8);
-            state->c = answer8;
+            Dcr<REG_C>(state, dead);
             break;
         case 0x0e:                              // MVI C
-            state->c = opcode[1];
-            state->pc++;
+            Mvi<REG_C>(state, opcode);
             break;
         case 0x0f:                              // RRC
+        {
             uint8_t x = state->a;
             state->a = ((x & 1) << 7) | (x >> 1);
             state->cc.cy = (1 == (x&1));
             break;
+        }
+        case 0x10: break;                       // NOP (undocumented)
         case 0x11:                              // LXI D
-            state->d = opcode[2];
-            state->e = opcode[1];
-            state->pc += 2;
-            break;   
-        case 0x12: UnimplementedInstruction(state); break;               
+            Lxi<PAIR_DE>(state, opcode);
+            break;
+        case 0x12:                              // STAX D
+            offset = state->de;
+            WriteMem(state, offset, state->a);
+            break;
         case 0x13:                              // INX D
-            state->e++;
-            if (state->e == 0) state->d++;
+            Inx<PAIR_DE>(state);
             break;
         case 0x14:                              // INR D
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->d + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->d = answer & 0xff;
+            Inr<REG_D>(state, dead);
             break;
         case 0x15:                              // DCR D
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->d - 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->d = answer & 0xff;
-            break;
-        case 0x16: UnimplementedInstruction(state); break;
-        case 0x17: UnimplementedInstruction(state); break;
-        case 0x18: UnimplementedInstruction(state); break;
+            Dcr<REG_D>(state, dead);
+            break;
+        case 0x16:                              // MVI D
+            Mvi<REG_D>(state, opcode);
+            break;
+        case 0x17:                              // RAL
+            {
+                uint8_t x = state->a;
+                state->a = state->cc.cy | (x << 1);
+                state->cc.cy = (0x80 == (x & 0x80));
+                break;
+            }
+        case 0x18: break;                       // NOP (undocumented)
         case 0x19:                              // DAD D
-            hl = (state->h<<8) | (state->l);
-            de = (state->d<<8) | (state->e);
-            answer32 = hl + de;
-            state->h = (answer32 & 0xff00) >> 8;
-            state->l = answer32 & 0xff;
-            state->cc.cy = ((answer32 & 0xffff0000) != 0); 
+            Dad<PAIR_DE>(state);
             break;
         case 0x1a:                              // LDAX D
-            offset = (state->d<<8) | (state->e);
-            state->a = state->memory[offset];
+            offset = state->de;
+            state->a = ReadMem(state, offset);
             break;
         case 0x1b:                              // DCX D
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->d<<8) | (state->e);
-            // state->memory[offset] = (state->memory[offset] - 1) & 0xff;
+            Dcx<PAIR_DE>(state);
             break;
         case 0x1c:                              // INR E
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->e + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->e = answer & 0xff;
+            Inr<REG_E>(state, dead);
             break;
         case 0x1d:                              // DCR E
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->e - 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->e = answer & 0xff;
-            break;
-        case 0x1e: UnimplementedInstruction(state); break;
-        case 0x1f:                              // RAR
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a;
-            // state->a = (state->cc.cy << 7) | (x >> 1);
-            // state->cc.cy = (1 == (x & 1));
+            Dcr<REG_E>(state, dead);
             break;
+        case 0x1e:                              // MVI E
+            Mvi<REG_E>(state, opcode);
+            break;
+        case 0x1f:                              // RAR
+            {
+                uint8_t x = state->a;
+                state->a = (state->cc.cy << 7) | (x >> 1);
+                state->cc.cy = (1 == (x & 1));
+                break;
+            }
+        case 0x20: break;                       // NOP (undocumented)
         case 0x21:                              // LXI H
-            state->h = opcode[2];
-            state->l = opcode[1];
-            state->pc += 2;
+            Lxi<PAIR_HL>(state, opcode);
+            break;
+        case 0x22:                              // SHLD address
+            offset = (opcode[2] << 8) | opcode[1];
+            WriteMem(state, offset, state->l);
+            WriteMem(state, offset + 1, state->h);
             break;
-        case 0x22: UnimplementedInstruction(state); break;
         case 0x23:                              // INX H
-            state->l++;
-            if (state->l == 0) state->h++;
+            Inx<PAIR_HL>(state);
             break;
         case 0x24:                              // INR H
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->h + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->h = answer & 0xff;
+            Inr<REG_H>(state, dead);
             break;
         case 0x25:                              // DCR H
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->h - 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->h = answer & 0xff;
+            Dcr<REG_H>(state, dead);
             break;
         case 0x26:                              // MVI H
-            state->h = opcode[1];
-            state->pc++;
-            break;
-        case 0x27: UnimplementedInstruction(state); break;
-        case 0x28: UnimplementedInstruction(state); break;
+            Mvi<REG_H>(state, opcode);
+            break;
+        case 0x27:                              // DAA
+            {
+                uint8_t correction = 0;
+                uint8_t cy = state->cc.cy;
+                uint8_t lsb = state->a & 0x0f;
+                uint8_t msb = state->a >> 4;
+                if (state->cc.ac || lsb > 9)
+                    correction += 0x06;
+                if (state->cc.cy || msb > 9 || (msb >= 9 && lsb > 9))
+                {
+                    correction += 0x60;
+                    cy = 1;
+                }
+                AddA(state, correction, 0, dead);
+                state->cc.cy = cy;
+                break;
+            }
+        case 0x28: break;                       // NOP (undocumented)
         case 0x29:                              // DAD H
-            hl = (state->h<<8) | (state->l);
-            answer32 = hl + hl;
-            state->h = (answer32 & 0xff00) >> 8;
-            state->l = answer32 & 0xff;
-            state->cc.cy = ((answer32 & 0xffff0000) != 0); 
+            Dad<PAIR_HL>(state);
+            break;
+        case 0x2a:                              // LHLD address
+            offset = (opcode[2] << 8) | opcode[1];
+            state->l = ReadMem(state, offset);
+            state->h = ReadMem(state, offset + 1);
             break;
-        case 0x2a: UnimplementedInstruction(state); break;
         case 0x2b:                              // DCX H
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // state->memory[offset] = (state->memory[offset] - 1) & 0xff;
+            Dcx<PAIR_HL>(state);
             break;
         case 0x2c:                              // INR L
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->l + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->l = answer & 0xff;
+            Inr<REG_L>(state, dead);
             break;
         case 0x2d:                              // DCR L
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->l - 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->l = answer & 0xff;
-            break;
-        case 0x2e: UnimplementedInstruction(state); break;
+            Dcr<REG_L>(state, dead);
+            break;
+        case 0x2e:                              // MVI L
+            Mvi<REG_L>(state, opcode);
+            break;
         case 0x2f:                              // CMA
-            UnimplementedInstruction(state);
-            // state->a = ~state->a;
+            state->a = ~state->a;
             break;
-        case 0x30: UnimplementedInstruction(state); break;
+        case 0x30: break;                       // NOP (undocumented)
         case 0x31:                              // LXI SP
-            state->sp = (opcode[2] << 8) | opcode[1];
-            state->pc += 2;
+            Lxi<PAIR_SP>(state, opcode);
             break;
         case 0x32:                              // STA address
             offset = (opcode[2] << 8) | opcode[1];
-            state->memory[offset] = state->a;
-            state->pc += 2;
+            WriteMem(state, offset, state->a);
             break;
-        case 0x33:
-            UnimplementedInstruction(state);
-            // state->sp = (state->sp + 1) & 0xff;
+        case 0x33:                              // INX SP
+            Inx<PAIR_SP>(state);
             break;
         case 0x34:                              // INR M
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint16_t answer = (uint16_t) state->memory[offset] + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->memory[offset] = answer & 0xff;
+            Inr<REG_M>(state, dead);
             break;
         case 0x35:                              // DCR M
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint16_t answer = (uint16_t) state->memory[offset] - 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->memory[offset] = answer & 0xff;
-            break;  
+            Dcr<REG_M>(state, dead);
+            break;
         case 0x36:                              // MVI M
-            offset = (state->h<<8) | (state->l);
-            state->memory[offset] = opcode[1];
-            state->pc++;
+            Mvi<REG_M>(state, opcode);
             break;
         case 0x37:                              // STC
-            UnimplementedInstruction(state);
-            // state->cc.cy = 1;
+            state->cc.cy = 1;
             break;
-        case 0x38: UnimplementedInstruction(state); break;
+        case 0x38: break;                       // NOP (undocumented)
         case 0x39:                              // DAD SP
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint16_t answer = state->memory[offset] + state->sp;
-            // state->cc.cy = (answer > 0xff); 
-            // state->memory[offset] = answer & 0xff;
+            Dad<PAIR_SP>(state);
             break;
         case 0x3a:                              // LDA address
             offset = (opcode[2] << 8) | opcode[1];
-            state->a = state->memory[offset];
-            state->pc+=2;
+            state->a = ReadMem(state, offset);
             break;
         case 0x3b:                              // DCX SP
-            UnimplementedInstruction(state);
-            // state->sp = (state->sp - 1) & 0xff;
+            Dcx<PAIR_SP>(state);
             break;
         case 0x3c:                              // INR A
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Inr<REG_A>(state, dead);
             break;
         case 0x3d:                              // DCR A
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - 1; 
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Dcr<REG_A>(state, dead);
             break;
         case 0x3e:                              // MVI A
-            state->a = opcode[1];
-            state->pc += 2;
+            Mvi<REG_A>(state, opcode);
             break;
         case 0x3f:                              // CMC
-            UnimplementedInstruction(state);
-            // state->cc.cy = (state->cc.cy == 1);
+            state->cc.cy = !state->cc.cy;
+            break;
+        case 0x40:                              // MOV B,B
+            Mov<REG_B, REG_B>(state);
             break;
         case 0x41:                              // MOV B,C
-            UnimplementedInstruction(state);
-            // state->b = state->c; 
-            break;  
+            Mov<REG_B, REG_C>(state);
+            break;
         case 0x42:                              // MOV B,D
-            UnimplementedInstruction(state);
-            // state->b = state->d;
-            break;  
+            Mov<REG_B, REG_D>(state);
+            break;
         case 0x43:                              // MOV B,E
-            UnimplementedInstruction(state);
-            // state->b = state->e; 
-            break;  
-        case 0x44: UnimplementedInstruction(state); break;
-        case 0x45: UnimplementedInstruction(state); break;
-        case 0x46: UnimplementedInstruction(state); break;
-        case 0x47: UnimplementedInstruction(state); break;
-        case 0x48: UnimplementedInstruction(state); break;
-        case 0x49: UnimplementedInstruction(state); break;
-        case 0x4a: UnimplementedInstruction(state); break;
-        case 0x4b: UnimplementedInstruction(state); break;
-        case 0x4c: UnimplementedInstruction(state); break;
-        case 0x4d: UnimplementedInstruction(state); break;
-        case 0x4e: UnimplementedInstruction(state); break;
-        case 0x4f: UnimplementedInstruction(state); break;
-        case 0x50: UnimplementedInstruction(state); break;
-        case 0x51: UnimplementedInstruction(state); break;
-        case 0x52: UnimplementedInstruction(state); break;
-        case 0x53: UnimplementedInstruction(state); break;
-        case 0x54: UnimplementedInstruction(state); break;
-        case 0x55: UnimplementedInstruction(state); break;
-        case 0x56:                              // MOV D, M
-            offset = (state->h<<8) | (state->l);
-            state->d = state->memory[offset];
-            break;
-        case 0x57: UnimplementedInstruction(state); break;
-        case 0x58: UnimplementedInstruction(state); break;
-        case 0x59: UnimplementedInstruction(state); break;
-        case 0x5a: UnimplementedInstruction(state); break;
-        case 0x5b: UnimplementedInstruction(state); break;
-        case 0x5c: UnimplementedInstruction(state); break;
-        case 0x5d: UnimplementedInstruction(state); break;
-        case 0x5e:                              // MOV E, M
-            offset = (state->h<<8) | (state->l);
-            state->e = state->memory[offset];
-            break;
-        case 0x5f: UnimplementedInstruction(state); break;
-        case 0x60: UnimplementedInstruction(state); break;
-        case 0x61: UnimplementedInstruction(state); break;
-        case 0x62: UnimplementedInstruction(state); break;
-        case 0x63: UnimplementedInstruction(state); break;
-        case 0x64: UnimplementedInstruction(state); break;
-        case 0x65: UnimplementedInstruction(state); break;
-        case 0x66:                              // MOV H, M
-            offset = (state->h<<8) | (state->l);
-            state->h = state->memory[offset];
-            break;
-        case 0x67: UnimplementedInstruction(state); break;
-        case 0x68: UnimplementedInstruction(state); break;
-        case 0x69: UnimplementedInstruction(state); break;
-        case 0x6a: UnimplementedInstruction(state); break;
-        case 0x6b: UnimplementedInstruction(state); break;
-        case 0x6c: UnimplementedInstruction(state); break;
-        case 0x6d: UnimplementedInstruction(state); break;
-        case 0x6e: UnimplementedInstruction(state); break;
-        case 0x6f:                              // MOV L, A   
-            state->l = state->a;
-            break;
-        case 0x70: UnimplementedInstruction(state); break;
-        case 0x71: UnimplementedInstruction(state); break;
-        case 0x72: UnimplementedInstruction(state); break;
-        case 0x73: UnimplementedInstruction(state); break;
-        case 0x74: UnimplementedInstruction(state); break;
-        case 0x75: UnimplementedInstruction(state); break;
-        case 0x76: UnimplementedInstruction(state); break;
-        case 0x77:                              // MOV M, A
-            offset = (state->h<<8) | (state->l);
-            state->memory[offset] = state->a;
-            break;
-        case 0x78: UnimplementedInstruction(state); break;
-        case 0x79: UnimplementedInstruction(state); break;
-        case 0x7a:                              // MOV A, D
-            state->a = state->d;
-            break;
-        case 0x7b:                              // MOV A, E
-            state->a = state->e;
-            break;
-        case 0x7c:                              // MOV A, H
-            state->a = state->h;
-            break;
-        case 0x7d: UnimplementedInstruction(state); break;
-        case 0x7e:                              // MOV A, M
-            offset = (state->h<<8) | (state->l);
-            state->a = state->memory[offset];
-            break;
-        case 0x7f: UnimplementedInstruction(state); break;
+            Mov<REG_B, REG_E>(state);
+            break;
+        case 0x44:                              // MOV B,H
+            Mov<REG_B, REG_H>(state);
+            break;
+        case 0x45:                              // MOV B,L
+            Mov<REG_B, REG_L>(state);
+            break;
+        case 0x46:                              // MOV B,M
+            Mov<REG_B, REG_M>(state);
+            break;
+        case 0x47:                              // MOV B,A
+            Mov<REG_B, REG_A>(state);
+            break;
+        case 0x48:                              // MOV C,B
+            Mov<REG_C, REG_B>(state);
+            break;
+        case 0x49:                              // MOV C,C
+            Mov<REG_C, REG_C>(state);
+            break;
+        case 0x4a:                              // MOV C,D
+            Mov<REG_C, REG_D>(state);
+            break;
+        case 0x4b:                              // MOV C,E
+            Mov<REG_C, REG_E>(state);
+            break;
+        case 0x4c:                              // MOV C,H
+            Mov<REG_C, REG_H>(state);
+            break;
+        case 0x4d:                              // MOV C,L
+            Mov<REG_C, REG_L>(state);
+            break;
+        case 0x4e:                              // MOV C,M
+            Mov<REG_C, REG_M>(state);
+            break;
+        case 0x4f:                              // MOV C,A
+            Mov<REG_C, REG_A>(state);
+            break;
+        case 0x50:                              // MOV D,B
+            Mov<REG_D, REG_B>(state);
+            break;
+        case 0x51:                              // MOV D,C
+            Mov<REG_D, REG_C>(state);
+            break;
+        case 0x52:                              // MOV D,D
+            Mov<REG_D, REG_D>(state);
+            break;
+        case 0x53:                              // MOV D,E
+            Mov<REG_D, REG_E>(state);
+            break;
+        case 0x54:                              // MOV D,H
+            Mov<REG_D, REG_H>(state);
+            break;
+        case 0x55:                              // MOV D,L
+            Mov<REG_D, REG_L>(state);
+            break;
+        case 0x56:                              // MOV D,M
+            Mov<REG_D, REG_M>(state);
+            break;
+        case 0x57:                              // MOV D,A
+            Mov<REG_D, REG_A>(state);
+            break;
+        case 0x58:                              // MOV E,B
+            Mov<REG_E, REG_B>(state);
+            break;
+        case 0x59:                              // MOV E,C
+            Mov<REG_E, REG_C>(state);
+            break;
+        case 0x5a:                              // MOV E,D
+            Mov<REG_E, REG_D>(state);
+            break;
+        case 0x5b:                              // MOV E,E
+            Mov<REG_E, REG_E>(state);
+            break;
+        case 0x5c:                              // MOV E,H
+            Mov<REG_E, REG_H>(state);
+            break;
+        case 0x5d:                              // MOV E,L
+            Mov<REG_E, REG_L>(state);
+            break;
+        case 0x5e:                              // MOV E,M
+            Mov<REG_E, REG_M>(state);
+            break;
+        case 0x5f:                              // MOV E,A
+            Mov<REG_E, REG_A>(state);
+            break;
+        case 0x60:                              // MOV H,B
+            Mov<REG_H, REG_B>(state);
+            break;
+        case 0x61:                              // MOV H,C
+            Mov<REG_H, REG_C>(state);
+            break;
+        case 0x62:                              // MOV H,D
+            Mov<REG_H, REG_D>(state);
+            break;
+        case 0x63:                              // MOV H,E
+            Mov<REG_H, REG_E>(state);
+            break;
+        case 0x64:                              // MOV H,H
+            Mov<REG_H, REG_H>(state);
+            break;
+        case 0x65:                              // MOV H,L
+            Mov<REG_H, REG_L>(state);
+            break;
+        case 0x66:                              // MOV H,M
+            Mov<REG_H, REG_M>(state);
+            break;
+        case 0x67:                              // MOV H,A
+            Mov<REG_H, REG_A>(state);
+            break;
+        case 0x68:                              // MOV L,B
+            Mov<REG_L, REG_B>(state);
+            break;
+        case 0x69:                              // MOV L,C
+            Mov<REG_L, REG_C>(state);
+            break;
+        case 0x6a:                              // MOV L,D
+            Mov<REG_L, REG_D>(state);
+            break;
+        case 0x6b:                              // MOV L,E
+            Mov<REG_L, REG_E>(state);
+            break;
+        case 0x6c:                              // MOV L,H
+            Mov<REG_L, REG_H>(state);
+            break;
+        case 0x6d:                              // MOV L,L
+            Mov<REG_L, REG_L>(state);
+            break;
+        case 0x6e:                              // MOV L,M
+            Mov<REG_L, REG_M>(state);
+            break;
+        case 0x6f:                              // MOV L,A
+            Mov<REG_L, REG_A>(state);
+            break;
+        case 0x70:                              // MOV M,B
+            Mov<REG_M, REG_B>(state);
+            break;
+        case 0x71:                              // MOV M,C
+            Mov<REG_M, REG_C>(state);
+            break;
+        case 0x72:                              // MOV M,D
+            Mov<REG_M, REG_D>(state);
+            break;
+        case 0x73:                              // MOV M,E
+            Mov<REG_M, REG_E>(state);
+            break;
+        case 0x74:                              // MOV M,H
+            Mov<REG_M, REG_H>(state);
+            break;
+        case 0x75:                              // MOV M,L
+            Mov<REG_M, REG_L>(state);
+            break;
+        case 0x76:                              // HLT
+            // wait for an interrupt by running HLT again until one comes,
+            // GenerateInterrupt steps over it. With interrupts off none
+            // can, and the machine has stopped.
+            state->halted = 1;
+            state->pc--;
+            break;
+        case 0x77:                              // MOV M,A
+            Mov<REG_M, REG_A>(state);
+            break;
+        case 0x78:                              // MOV A,B
+            Mov<REG_A, REG_B>(state);
+            break;
+        case 0x79:                              // MOV A,C
+            Mov<REG_A, REG_C>(state);
+            break;
+        case 0x7a:                              // MOV A,D
+            Mov<REG_A, REG_D>(state);
+            break;
+        case 0x7b:                              // MOV A,E
+            Mov<REG_A, REG_E>(state);
+            break;
+        case 0x7c:                              // MOV A,H
+            Mov<REG_A, REG_H>(state);
+            break;
+        case 0x7d:                              // MOV A,L
+            Mov<REG_A, REG_L>(state);
+            break;
+        case 0x7e:                              // MOV A,M
+            Mov<REG_A, REG_M>(state);
+            break;
+        case 0x7f:                              // MOV A,A
+            Mov<REG_A, REG_A>(state);
+            break;
         case 0x80:                              // ADD B
-            UnimplementedInstruction(state);
-            // do the math with higher precision so we can capture the
-            // carry out
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->b;
-
-            // Zero flag: if the result is zero,
-            // set the flag to zero
-            // else clear the flag
-            // if ((answer & 0xff) == 0)
-            //     state->cc.z = 1;
-            // else
-            //     state->cc.z = 0;
-            
-            // Sign flag: if bit 7 is set,
-            // set the sign flag
-            // else clear the sign flag
-            // if (answer & 0x80)
-            //     state->cc.s = 1;
-            // else
-            //     state->cc.s = 0;
-            // Carry flag
-            // if (answer > 0xff)
-            //     state->cc.cy = 1;
-            // else
-            //     state->cc.cy = 0;
-
-            // Parity flag: if parity is even,
-            // set the parity flag
-            // else clear the parity flag
-            // if (answer & 0x01 == 0)
-            //     state->cc.p = 1;
-            // else
-            //     state->cc.p = 0;
-            
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_B>(state, dead);
             break;
         case 0x81:                              // ADD C
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->c;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_C>(state, dead);
             break;
         case 0x82:                              // ADD D
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->d;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_D>(state, dead);
             break;
         case 0x83:                              // ADD E
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->e;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_E>(state, dead);
             break;
         case 0x84:                              // ADD H
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->h;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_H>(state, dead);
             break;
         case 0x85:                              // ADD L
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->h;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_L>(state, dead);
             break;
         case 0x86:                              // ADD M
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint16_t answer = (uint16_t) state->a + state->memory[offset];
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_M>(state, dead);
             break;
         case 0x87:                              // ADD A
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->a;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADD, REG_A>(state, dead);
             break;
         case 0x88:                              // ADC B
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->b + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_B>(state, dead);
             break;
         case 0x89:                              // ADC C
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->c + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_C>(state, dead);
             break;
         case 0x8a:                              // ADC D
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->d + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_D>(state, dead);
             break;
         case 0x8b:                              // ADC E
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->e + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_E>(state, dead);
             break;
         case 0x8c:                              // ADC H
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->h + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_H>(state, dead);
             break;
         case 0x8d:                              // ADC L
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->l + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_L>(state, dead);
             break;
         case 0x8e:                              // ADC M
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->memory[offset] + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_M>(state, dead);
             break;
         case 0x8f:                              // ADC A
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) state->a + (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_ADC, REG_A>(state, dead);
             break;
         case 0x90:                              // SUB B
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->b;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SUB, REG_B>(state, dead);
             break;
         case 0x91:                              // SUB C
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->c;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SUB, REG_C>(state, dead);
             break;
         case 0x92:                              // SUB D
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->d;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SUB, REG_D>(state, dead);
             break;
         case 0x93:                              // SUB E
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->e;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SUB, REG_E>(state, dead);
             break;
         case 0x94:                              // SUB H
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->h;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
-            break; 
+            Alu<ALU_SUB, REG_H>(state, dead);
+            break;
         case 0x95:                              // SUB L
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->l;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SUB, REG_L>(state, dead);
             break;
         case 0x96:                              // SUB M
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->memory[offset];   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SUB, REG_M>(state, dead);
             break;
         case 0x97:                              // SUB A
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->a;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SUB, REG_A>(state, dead);
             break;
         case 0x98:                              // SBB B
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->b - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SBB, REG_B>(state, dead);
             break;
         case 0x99:                              // SBB C
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->c - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SBB, REG_C>(state, dead);
             break;
         case 0x9a:                              // SBB D
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->d - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SBB, REG_D>(state, dead);
             break;
         case 0x9b:                              // SBB E
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->e - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SBB, REG_E>(state, dead);
             break;
         case 0x9c:                              // SBB H
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->h - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SBB, REG_H>(state, dead);
             break;
         case 0x9d:                              // SBB L
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->l - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SBB, REG_L>(state, dead);
             break;
         case 0x9e:                              // SBB M
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->memory[offset] - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+            Alu<ALU_SBB, REG_M>(state, dead);
             break;
         case 0x9f:                              // SBB A
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) state->a - (uint16_t) state->cc.cy;   
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
-            break;
-        case 0xa0: UnimplementedInstruction(state); break;
-        case 0xa1: UnimplementedInstruction(state); break;
-        case 0xa2: UnimplementedInstruction(state); break;
-        case 0xa3: UnimplementedInstruction(state); break;
-        case 0xa4: UnimplementedInstruction(state); break;
-        case 0xa5: UnimplementedInstruction(state); break;
-        case 0xa6: UnimplementedInstruction(state); break;
+            Alu<ALU_SBB, REG_A>(state, dead);
+            break;
+        case 0xa0:                              // ANA B
+            Alu<ALU_ANA, REG_B>(state, dead);
+            break;
+        case 0xa1:                              // ANA C
+            Alu<ALU_ANA, REG_C>(state, dead);
+            break;
+        case 0xa2:                              // ANA D
+            Alu<ALU_ANA, REG_D>(state, dead);
+            break;
+        case 0xa3:                              // ANA E
+            Alu<ALU_ANA, REG_E>(state, dead);
+            break;
+        case 0xa4:                              // ANA H
+            Alu<ALU_ANA, REG_H>(state, dead);
+            break;
+        case 0xa5:                              // ANA L
+            Alu<ALU_ANA, REG_L>(state, dead);
+            break;
+        case 0xa6:                              // ANA M
+            Alu<ALU_ANA, REG_M>(state, dead);
+            break;
         case 0xa7:                              // ANA A
-            answer8 = state->a & state->a;
-            LogicFlagsA(state);
-            break;
-        case 0xa8: UnimplementedInstruction(state); break;
-        case 0xa9: UnimplementedInstruction(state); break;
-        case 0xaa: UnimplementedInstruction(state); break;
-        case 0xab: UnimplementedInstruction(state); break;
-        case 0xac: UnimplementedInstruction(state); break;
-        case 0xad: UnimplementedInstruction(state); break;
-        case 0xae: UnimplementedInstruction(state); break;
+            Alu<ALU_ANA, REG_A>(state, dead);
+            break;
+        case 0xa8:                              // XRA B
+            Alu<ALU_XRA, REG_B>(state, dead);
+            break;
+        case 0xa9:                              // XRA C
+            Alu<ALU_XRA, REG_C>(state, dead);
+            break;
+        case 0xaa:                              // XRA D
+            Alu<ALU_XRA, REG_D>(state, dead);
+            break;
+        case 0xab:                              // XRA E
+            Alu<ALU_XRA, REG_E>(state, dead);
+            break;
+        case 0xac:                              // XRA H
+            Alu<ALU_XRA, REG_H>(state, dead);
+            break;
+        case 0xad:                              // XRA L
+            Alu<ALU_XRA, REG_L>(state, dead);
+            break;
+        case 0xae:                              // XRA M
+            Alu<ALU_XRA, REG_M>(state, dead);
+            break;
         case 0xaf:                              // XRA A
-            answer8 = state->a ^ state->a;
-            LogicFlagsA(state);
-            break;
-        case 0xb0: UnimplementedInstruction(state); break;
-        case 0xb1: UnimplementedInstruction(state); break;
-        case 0xb2: UnimplementedInstruction(state); break;
-        case 0xb3: UnimplementedInstruction(state); break;
-        case 0xb4: UnimplementedInstruction(state); break;
-        case 0xb5: UnimplementedInstruction(state); break;
-        case 0xb6: UnimplementedInstruction(state); break;
-        case 0xb7: UnimplementedInstruction(state); break;
+            Alu<ALU_XRA, REG_A>(state, dead);
+            break;
+        case 0xb0:                              // ORA B
+            Alu<ALU_ORA, REG_B>(state, dead);
+            break;
+        case 0xb1:                              // ORA C
+            Alu<ALU_ORA, REG_C>(state, dead);
+            break;
+        case 0xb2:                              // ORA D
+            Alu<ALU_ORA, REG_D>(state, dead);
+            break;
+        case 0xb3:                              // ORA E
+            Alu<ALU_ORA, REG_E>(state, dead);
+            break;
+        case 0xb4:                              // ORA H
+            Alu<ALU_ORA, REG_H>(state, dead);
+            break;
+        case 0xb5:                              // ORA L
+            Alu<ALU_ORA, REG_L>(state, dead);
+            break;
+        case 0xb6:                              // ORA M
+            Alu<ALU_ORA, REG_M>(state, dead);
+            break;
+        case 0xb7:                              // ORA A
+            Alu<ALU_ORA, REG_A>(state, dead);
+            break;
         case 0xb8:                              // CMP B
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a - state->b;
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_B>(state, dead);
             break;
         case 0xb9:                              // CMP C
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a - state->c;
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_C>(state, dead);
             break;
         case 0xba:                              // CMP D
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a - state->d;
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_D>(state, dead);
             break;
         case 0xbb:                              // CMP E
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a - state->e;
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_E>(state, dead);
             break;
         case 0xbc:                              // CMP H
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a - state->h;
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_H>(state, dead);
             break;
         case 0xbd:                              // CMP L
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a - state->l;
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_L>(state, dead);
             break;
         case 0xbe:                              // CMP M
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // uint8_t x = state->a - state->memory[offset];
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_M>(state, dead);
             break;
         case 0xbf:                              // CMP A
-            UnimplementedInstruction(state);
-            // uint8_t x = state->a - state->a;
-            // state->cc.z = (x == 0);
-            // state->cc.s = ((x & 0x80) == 0x80);
-            // state->cc.p = ((x & 0x01) == 0); 
-            // state->cc.cy = (state->a < opcode[1]);
-            // state->pc++;
+            Alu<ALU_CMP, REG_A>(state, dead);
             break;
         case 0xc0:                              // RNZ
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.z) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
+            Return(state, opcode, 0 == state->cc.z);
             break;
         case 0xc1:                              // POP B
-            state->c = state->memory[state->sp];
-            state->b = state->memory[state->sp+1];
+            state->c = ReadMem(state, state->sp);
+            state->b = ReadMem(state, state->sp+1);
             state->sp += 2;
             break;
         case 0xc2:                              // JNZ address
-            if (0 == state->cc.z)
-                state->pc = (opcode[2] << 8) | opcode[1];
-            else 
-                // branch not taken
-                state->pc += 2;
+            Jump(state, opcode, 0 == state->cc.z);
             break;
         case 0xc3:                              // JMP address
-            state->pc = (opcode[2] << 8) | opcode[1];
+            Jump(state, opcode, 1);
             break;
         case 0xc4:                              // CNZ address
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.z) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
+            Call(state, opcode, 0 == state->cc.z);
             break;
         case 0xc5:                              // PUSH B
-            state->memory[state->sp - 1] = state->b;
-            state->memory[state->sp - 2] = state->c;
+            WriteMem(state, state->sp - 1, state->b);
+            WriteMem(state, state->sp - 2, state->c);
             state->sp = state->sp - 2;
             break;
         case 0xc6:                              // ADI byte
-            answer16 = (uint16_t) state->a + (uint16_t) opcode[1];
-            state->cc.z =  ((answer16 & 0xff) == 0);    
-            state->cc.s = ((answer16 & 0x80) == 0x80);    
-            state->cc.cy = (answer16 > 0xff);    
-            state->cc.p = parity((answer16 & 0xff), 8);
-            state->a = (uint8_t) answer16;
-            state->pc++;
-            break;
-        case 0xc7: UnimplementedInstruction(state); break;
-        case 0xc8:                              // RZ address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.z) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
+            AddA(state, opcode[1], 0, dead);
+            break;
+        case 0xc7:                              // RST 0
+            Push(state, state->pc);
+            state->pc = 0x00;
+            break;
+        case 0xc8:                              // RZ
+            Return(state, opcode, 1 == state->cc.z);
             break;
         case 0xc9:                              // RET
-            state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            state->sp += 2;
+            Return(state, opcode, 1);
             break;
         case 0xca:                              // JZ address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.z)
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // else 
-            //     // branch not taken
-            //     state->pc += 2;
-            break;
-        case 0xcb: UnimplementedInstruction(state); break;
+            Jump(state, opcode, 1 == state->cc.z);
+            break;
+        case 0xcb:                              // JMP address (undocumented)
+            Jump(state, opcode, 1);
+            break;
         case 0xcc:                              // CZ address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.z) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
+            Call(state, opcode, 1 == state->cc.z);
             break;
         case 0xcd:                              // CALL address
-            uint16_t ret = state->pc+2;
-            state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            state->memory[state->sp-2] = (ret & 0xff);
-            state->sp = state->sp - 2;
-            state->pc = (opcode[2] << 8) | opcode[1];
+            Call(state, opcode, 1);
             break;
         case 0xce:                              // ACI byte
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a + (uint16_t) opcode[1] + state->cc.cy;
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
-            break;
-        case 0xcf: UnimplementedInstruction(state); break;
+            AddA(state, opcode[1], state->cc.cy, dead);
+            break;
+        case 0xcf:                              // RST 1
+            Push(state, state->pc);
+            state->pc = 0x08;
+            break;
         case 0xd0:                              // RNC
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.cy) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
+            Return(state, opcode, 0 == state->cc.cy);
             break;
         case 0xd1:                              // POP D
-            state->e = state->memory[state->sp];
-            state->d = state->memory[state->sp+1];
+            state->e = ReadMem(state, state->sp);
+            state->d = ReadMem(state, state->sp+1);
             state->sp += 2;
             break;
         case 0xd2:                              // JNC address
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.cy)
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // else 
-            //     // branch not taken
-            //     state->pc += 2;
+            Jump(state, opcode, 0 == state->cc.cy);
             break;
-        case 0xd3:                              // OUT
-            state->pc++;
+        case 0xd3:                              // OUT port
+            if (state->port_out != NULL)
+                state->port_out(state, opcode[1], state->a);
             break;
         case 0xd4:                              // CNC address
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.cy) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
+            Call(state, opcode, 0 == state->cc.cy);
             break;
         case 0xd5:                              // PUSH D
-            state->memory[state->sp - 1] = state->d;
-            state->memory[state->sp - 2] = state->e;
+            WriteMem(state, state->sp - 1, state->d);
+            WriteMem(state, state->sp - 2, state->e);
             state->sp = state->sp - 2;
             break;
-        case 0xd6:                              // SUI D8
-            UnimplementedInstruction(state);
-            // uint16_t answer = (uint16_t) state->a - (uint16_t) opcode[1];
-            // state->cc.z =  ((answer & 0xff) == 0);    
-            // state->cc.s = ((answer & 0x80) != 0);    
-            // state->cc.cy = (answer > 0xff);    
-            // state->cc.p = ((answer & 0x01) == 0);
-            // state->a = answer & 0xff;
+        case 0xd6:                              // SUI byte
+            SubA(state, opcode[1], 0, dead);
+            break;
+        case 0xd7:                              // RST 2
+            Push(state, state->pc);
+            state->pc = 0x10;
             break;
-        case 0xd7: UnimplementedInstruction(state); break;
         case 0xd8:                              // RC
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.cy) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
-            break;
-        case 0xd9: UnimplementedInstruction(state); break;
+            Return(state, opcode, 1 == state->cc.cy);
+            break;
+        case 0xd9:                              // RET (undocumented)
+            Return(state, opcode, 1);
+            break;
         case 0xda:                              // JC address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.cy)
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // else 
-            //     // branch not taken
-            //     state->pc += 2;
-            break;
-        case 0xdb: UnimplementedInstruction(state); break;
+            Jump(state, opcode, 1 == state->cc.cy);
+            break;
+        case 0xdb:                              // IN port
+            if (state->port_in != NULL)
+                state->a = state->port_in(state, opcode[1]);
+            else
+                state->a = 0;
+            break;
         case 0xdc:                              // CC address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.cy) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
-            break;
-        case 0xdd: UnimplementedInstruction(state); break;
-        case 0xde: UnimplementedInstruction(state); break;
-        case 0xdf: UnimplementedInstruction(state); break;
+            Call(state, opcode, 1 == state->cc.cy);
+            break;
+        case 0xdd:                              // CALL address (undocumented)
+            Call(state, opcode, 1);
+            break;
+        case 0xde:                              // SBI byte
+            SubA(state, opcode[1], state->cc.cy, dead);
+            break;
+        case 0xdf:                              // RST 3
+            Push(state, state->pc);
+            state->pc = 0x18;
+            break;
         case 0xe0:                              // RPO
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.p) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
+            Return(state, opcode, 0 == state->cc.p);
             break;
         case 0xe1:                              // POP H
-            state->l = state->memory[state->sp];
-            state->h = state->memory[state->sp+1];
+            state->l = ReadMem(state, state->sp);
+            state->h = ReadMem(state, state->sp+1);
             state->sp += 2;
             break;
         case 0xe2:                              // JPO address
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.p)
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // else 
-            //     // branch not taken
-            //     state->pc += 2;
+            Jump(state, opcode, 0 == state->cc.p);
             break;
         case 0xe3:                              // XTHL
-            UnimplementedInstruction(state);
-            // uint8_t temp = state->memory[state->sp];
-            // state->memory[state->sp] = state->l;
-            // state->l = temp;
-            // temp = state->memory[state->sp + 1];
-            // state->memory[state->sp + 1] = state->h;
-            // state->h = temp;
-            break;
+            {
+                uint8_t temp = ReadMem(state, state->sp);
+                WriteMem(state, state->sp, state->l);
+                state->l = temp;
+                temp = ReadMem(state, state->sp + 1);
+                WriteMem(state, state->sp + 1, state->h);
+                state->h = temp;
+                break;
+            }
         case 0xe4:                              // CPO address
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.p) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
+            Call(state, opcode, 0 == state->cc.p);
             break;
         case 0xe5:                              // PUSH H
-            state->memory[state->sp - 1] = state->h;
-            state->memory[state->sp - 2] = state->l;
+            WriteMem(state, state->sp - 1, state->h);
+            WriteMem(state, state->sp - 2, state->l);
             state->sp = state->sp - 2;
             break;
-        case 0xe6:                              // ANI
-            state->a = state->a & opcode[1];
-            LogicFlagsA(state);
-            state->pc++;
+        case 0xe6:                              // ANI byte
+            AndA(state, opcode[1], dead);
+            break;
+        case 0xe7:                              // RST 4
+            Push(state, state->pc);
+            state->pc = 0x20;
             break;
-        case 0xe7: UnimplementedInstruction(state); break;
         case 0xe8:                              // RPE
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.cy) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
-            break;
-        case 0xe9: UnimplementedInstruction(state); break;
+            Return(state, opcode, 1 == state->cc.p);
+            break;
+        case 0xe9:                              // PCHL
+            state->pc = state->hl;
+            break;
         case 0xea:                              // JPE address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.p)
-            //         state->pc = (opcode[2] << 8) | opcode[1];
-            // else 
-            //     // branch not taken
-            //     state->pc += 2;
+            Jump(state, opcode, 1 == state->cc.p);
             break;
         case 0xeb:                              // XCHG
-            uint8_t temp = state->d;
-            state->d = state->h;
-            state->h = temp;
-            temp = state->e;
-            state->e = state->l;
-            state->l = temp;
+        {
+            uint16_t temp = state->de;
+            state->de = state->hl;
+            state->hl = temp;
             break;
+        }
         case 0xec:                              // CPE address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.p) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
-            break;
-        case 0xed: UnimplementedInstruction(state); break;
-        case 0xef: UnimplementedInstruction(state); break;
+            Call(state, opcode, 1 == state->cc.p);
+            break;
+        case 0xed:                              // CALL address (undocumented)
+            Call(state, opcode, 1);
+            break;
+        case 0xee:                              // XRI byte
+            XorA(state, opcode[1], dead);
+            break;
+        case 0xef:                              // RST 5
+            Push(state, state->pc);
+            state->pc = 0x28;
+            break;
         case 0xf0:                              // RP
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.s) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
+            Return(state, opcode, 0 == state->cc.s);
             break;
         case 0xf1:                              // POP PSW
-            state->a = state->memory[state->sp + 1];
-            uint8_t psw = state->memory[state->sp];
-            state->cc.z = (0x01 == (psw & 0x01));
-            state->cc.s = (0x02 == (psw & 0x02));
-            state->cc.p = (0x04 == (psw & 0x04));
-            state->cc.cy = (0x05 == (psw & 0x08));
-            state->cc.ac = (0x10 == (psw & 0x10));
-            state->sp += 2;
+            state->psw = Pop(state);
             break;
         case 0xf2:                              // JP address
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.s)
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // else 
-            //     // branch not taken
-            //     state->pc += 2;
-            // break;
+            Jump(state, opcode, 0 == state->cc.s);
+            break;
         case 0xf3:                              // DI
-            UnimplementedInstruction(state);
-            // state->int_enable = 0;
+            state->int_enable = 0;
             break;
         case 0xf4:                              // CP address
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.s) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
+            Call(state, opcode, 0 == state->cc.s);
             break;
         case 0xf5:                              // PUSH PSW
-            state->memory[state->sp-1] = state->a;
-            uint8_t psw = (state->cc.z |
-                            state->cc.s << 1 |
-                            state->cc.p << 2 |
-                            state->cc.cy << 3|
-                            state->cc.ac << 4 );
-            state->memory[state->sp - 2] = psw;
-            state->sp = state-> sp - 2;
-            break;
-        case 0xf6: UnimplementedInstruction(state); break;
-        case 0xf7: UnimplementedInstruction(state); break;
+            Push(state, PackPSW(state));
+            break;
+        case 0xf6:                              // ORI byte
+            OrA(state, opcode[1], dead);
+            break;
+        case 0xf7:                              // RST 6
+            Push(state, state->pc);
+            state->pc = 0x30;
+            break;
         case 0xf8:                              // RM
-            UnimplementedInstruction(state);
-            // if (0 == state->cc.cy) {
-            //     state->pc = state->memory[state->sp] | (state->memory[state->sp+1] << 8);
-            //     state->sp += 2;
-            // }
-            // else
-            //     state->pc += 2;
+            Return(state, opcode, 1 == state->cc.s);
             break;
         case 0xf9:                              // SPHL
-            UnimplementedInstruction(state);
-            // uint16_t offset = (state->h<<8) | (state->l);
-            // state->memory[state->sp] = state->memory[offset];
+            state->sp = state->hl;
             break;
         case 0xfa:                              // JM address
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.s)
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // else 
-            //     // branch not taken
-            //     state->pc += 2;
-            break; 
+            Jump(state, opcode, 1 == state->cc.s);
+            break;
         case 0xfb:                              // EI
             state->int_enable = 1;
             break;
-        case 0xfc:                              // CM addresss
-            UnimplementedInstruction(state);
-            // if (1 == state->cc.s) {
-            //     uint16_t ret = state->pc+2;
-            //     state->memory[state->sp-1] = (ret >> 8) & 0xff;
-            //     state->memory[state->sp-2] = (ret & 0xff);
-            //     state->sp = state->sp - 2;
-            //     state->pc = (opcode[2] << 8) | opcode[1];
-            // }
-            // else
-            //     // branch not taken
-            //     state->pc += 2;
-            break;
-        case 0xfd: UnimplementedInstruction(state); break;
+        case 0xfc:                              // CM address
+            Call(state, opcode, 1 == state->cc.s);
+            break;
+        case 0xfd:                              // CALL address (undocumented)
+            Call(state, opcode, 1);
+            break;
         case 0xfe:                              // CPI byte
-            answer8 = state->a - opcode[1];
-            state->cc.z = (answer8 == 0);
-            state->cc.s = ((answer8 & 0x80) == 0x80);
-            state->cc.p = parity(answer8, 8); 
-            state->cc.cy = (state->a < opcode[1]);
-            state->pc++;
-            break;
-        case 0xff: UnimplementedInstruction(state); break;
+            CmpA(state, opcode[1], dead);
+            break;
+        case 0xff:                              // RST 7
+            Push(state, state->pc);
+            state->pc = 0x38;
+            break;
     }
+#if PRINTOPS
     printf("\t");
 	printf("%c", state->cc.z ? 'z' : '.');
 	printf("%c", state->cc.s ? 's' : '.');
@@ -1294,44 +1156,138 @@ int Emulate8080p(State8080* state)
 	printf("%c  ", state->cc.ac ? 'a' : '.');
 	printf("A $%02x B $%02x C $%02x D $%02x E $%02x H $%02x L $%02x SP %04x\n", state->a, state->b, state->c,
 				state->d, state->e, state->h, state->l, state->sp);
-	return 0;
+#endif
+#if PROFILE_CALLS
+    if (state->calls != NULL)
+        ProfileCallsOp(state->calls, state, op, sp_before);
+#endif
+    return Stopped8080(state) ? STATUS_HALTED : STATUS_OK;
 }
 
-void ReadFileIntoMemoryAt(State8080* state, char* filename, uint32_t offset)
+void GenerateInterrupt(State8080* state, int interrupt_num)
 {
-    FILE *f= fopen(filename, "rb");
-    if (f==NULL)
+    // a halted cpu resumes after the HLT
+    if (state->halted)
     {
-        printf("error: Couldn't open %s\n", filename);
-        exit(1);
+        state->halted = 0;
+        state->pc++;
     }
+
+    // push pc, then jump to the RST vector
+    Push(state, state->pc);
+    state->pc = 8 * interrupt_num;
+    state->int_enable = 0;
+    state->cycles += 11;
+    state->interrupts++;
+#if PROFILE_CALLS
+    if (state->calls != NULL)
+        ProfileInterrupt(state->calls, state, interrupt_num);
+#endif
+}
+
+/*
+Loads a file into memory at offset, nothing past the end of the 64K.
+
+returns STATUS_OK, or why it couldn't
+*/
+int ReadFileIntoMemoryAt(State8080* state, const char* filename, uint32_t offset)
+{
+    FILE *f= fopen(filename, "rb");
+    if (f==NULL)
+        return STATUS_OPEN_FAILED;
     fseek(f, 0L, SEEK_END);
-    int fsize = ftell(f);
+    long fsize = ftell(f);
     fseek(f, 0L, SEEK_SET);
+    if (fsize < 0 || offset + fsize > 0x10000)
+    {
+        fclose(f);
+        return STATUS_TOO_BIG;
+    }
 
     uint8_t *buffer = &state->memory[offset];
-    fread(buffer, fsize, 1, f);
+    size_t got = fread(buffer, 1, fsize, f);
     fclose(f);
+    return got == (size_t) fsize ? STATUS_OK : STATUS_READ_FAILED;
 }
 
+/*
+returns a new machine with zeroed registers and memory, or NULL if out
+of memory
+*/
 State8080* Init8080()
 {
     State8080* state = (State8080*) calloc(1, sizeof(State8080));
-    state->memory = (uint8_t*) malloc(0x10000); //16K
+    if (state == NULL)
+        return NULL;
+    state->memory = (uint8_t*) calloc(0x10000, 1); //64K
+    if (state->memory == NULL)
+    {
+        free(state);
+        return NULL;
+    }
     return state;
 }
 
-int main (int argc, char**argv)
+void Destroy8080(State8080* state)
+{
+    if (state == NULL)
+        return;
+    free(state->memory);
+    free(state);
+}
+
+// Power-on state for the cpu, the cycle, instruction and interrupt counts
+// starting again from 0. Memory, the port callbacks and anything attached
+// for profiling stay as they are.
+void Reset8080(State8080* state)
 {
-    int done = 0;
-    int vblankcycles = 0;
-    State8080* state = Init8080();
+    state->bc = state->de = state->hl = state->psw = 0;
+    state->sp = 0;
+    state->pc = 0;
+    state->int_enable = 0;
+    state->halted = 0;
+    state->cycles = 0;
+    state->instructions = 0;
+    state->interrupts = 0;
+}
 
-    ReadFileIntoMemoryAt(state, "invaders", 0);
+/*
+Runs whole instructions until at least cycles more have gone by.
 
-    while (done == 0)
+returns STATUS_OK, or STATUS_HALTED if the machine stopped first
+*/
+int Run8080(State8080* state, uint64_t cycles)
+{
+    // counted in a local so the loop doesn't store to state for it
+    uint64_t end = state->cycles + cycles;
+    uint64_t retired = 0;
+    int status = STATUS_OK;
+    while (state->cycles < end)
     {
-        done = Emulate8080p(state);
+        retired++;
+        if (Emulate8080p(state))
+        {
+            status = STATUS_HALTED;
+            break;
+        }
     }
-    return 0;
-}
\ No newline at end of file
+    state->instructions += retired;
+    return status;
+}
+
+const char* StatusString8080(int status)
+{
+    switch (status)
+    {
+        case STATUS_OK: return "ok";
+        case STATUS_HALTED: return "halted";
+        case STATUS_NO_MEMORY: return "out of memory";
+        case STATUS_OPEN_FAILED: return "couldn't open file";
+        case STATUS_TOO_BIG: return "file doesn't fit in memory";
+        case STATUS_READ_FAILED: return "couldn't read file";
+        case STATUS_BAD_ROM: return "not a known ROM set";
+        case STATUS_WRITE_FAILED: return "couldn't write file";
+        case STATUS_BAD_FORMAT: return "not a save state, or a damaged one";
+    }
+    return "unknown status";
+}
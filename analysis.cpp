@@ -0,0 +1,342 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "functions.h"
+#include "analysis.h"
+#include "opcodes.h"
+
+static uint16_t Target(const unsigned char* code)
+{
+    // RST n calls 8 * n
+    if (opinfo8080[code[0]].flow == FLOW_RST)
+        return code[0] & 0x38;
+    return (code[2] << 8) | code[1];
+}
+
+/*
+Walks every path reachable from the entry points, marking instruction
+starts and block leaders, then cuts the marked code into basic blocks.
+
+returns the number of blocks found
+*/
+int AnalyzeCode(const unsigned char* memory, uint32_t size, const uint16_t* entries, int nentries,
+                CodeMap8080* map)
+{
+    memset(map->flags, 0, sizeof(map->flags));
+    map->nblocks = 0;
+    map->size = size;
+
+    static uint16_t worklist[0x10000];
+    int pending = 0;
+    for (int i = 0; i < nentries; i++)
+    {
+        worklist[pending++] = entries[i];
+        map->flags[entries[i]] |= CODE_LEADER;
+    }
+
+    while (pending > 0)
+    {
+        uint32_t pc = worklist[--pending];
+        while (pc < size)
+        {
+            if (map->flags[pc] & CODE_INSN)
+                break;                      // already traced from here
+            if (map->flags[pc] & CODE_OPERAND)
+            {
+                map->flags[pc] |= CODE_OVERLAP;
+                break;
+            }
+
+            const unsigned char* code = &memory[pc];
+            Instruction8080 op;
+            int length = Decode8080Op(code, &op);
+            map->flags[pc] |= CODE_INSN;
+            for (int i = 1; i < length && pc + i < size; i++)
+                map->flags[pc + i] |= CODE_OPERAND;
+
+            int flow = opinfo8080[op.opcode].flow;
+            if (flow == FLOW_JUMP || flow == FLOW_BRANCH || flow == FLOW_CALL ||
+                flow == FLOW_CONDITIONAL_CALL || flow == FLOW_RST)
+            {
+                uint16_t target = Target(code);
+                if (!(map->flags[target] & CODE_LEADER) && pending < 0x10000)
+                    worklist[pending++] = target;
+                map->flags[target] |= CODE_LEADER;
+            }
+            pc += length;
+
+            if (flow == FLOW_JUMP || flow == FLOW_RETURN || flow == FLOW_INDIRECT)
+                break;
+            // anything else that can change pc ends the block, and the next
+            // instruction starts a new one
+            if (flow != FLOW_NONE && pc < size)
+                map->flags[pc] |= CODE_LEADER;
+        }
+    }
+
+    // cut blocks at leaders and at control transfers
+    BasicBlock8080* block = NULL;
+    for (uint32_t pc = 0; pc < size; )
+    {
+        if (!(map->flags[pc] & CODE_INSN))
+        {
+            block = NULL;
+            pc++;
+            continue;
+        }
+        if (block == NULL || (map->flags[pc] & CODE_LEADER))
+        {
+            if (block != NULL)
+            {
+                block->exit = EXIT_FALLTHROUGH;
+                block->nsucc = 1;
+                block->succ[0] = pc;
+            }
+            if (map->nblocks == MAX_BLOCKS)
+                break;
+            block = &map->blocks[map->nblocks++];
+            block->start = pc;
+            block->exit = EXIT_END;
+            block->nsucc = 0;
+        }
+
+        const unsigned char* code = &memory[pc];
+        Instruction8080 op;
+        int length = Decode8080Op(code, &op);
+        block->last = pc;
+        block->end = pc + length;
+        pc += length;
+
+        int flow = opinfo8080[op.opcode].flow;
+        if (flow == FLOW_NONE)
+            continue;
+
+        block->nsucc = 0;
+        switch (flow)
+        {
+            case FLOW_JUMP:
+                block->exit = EXIT_JUMP;
+                block->succ[block->nsucc++] = Target(code);
+                break;
+            case FLOW_BRANCH:
+                block->exit = EXIT_BRANCH;
+                block->succ[block->nsucc++] = Target(code);
+                block->succ[block->nsucc++] = pc;
+                break;
+            case FLOW_CALL:
+            case FLOW_CONDITIONAL_CALL:
+            case FLOW_RST:
+                block->exit = EXIT_CALL;
+                block->succ[block->nsucc++] = Target(code);
+                block->succ[block->nsucc++] = pc;
+                break;
+            case FLOW_RETURN:
+                block->exit = EXIT_RETURN;
+                break;
+            case FLOW_CONDITIONAL_RETURN:
+                block->exit = EXIT_RETURN;
+                block->succ[block->nsucc++] = pc;
+                break;
+            case FLOW_INDIRECT:
+                block->exit = EXIT_INDIRECT;
+                break;
+            case FLOW_HALT:
+                block->exit = EXIT_HALT;
+                block->succ[block->nsucc++] = pc;
+                break;
+        }
+        block = NULL;
+    }
+    return map->nblocks;
+}
+
+/*
+returns the index of the block containing address, or -1
+*/
+int FindBlock(const CodeMap8080* map, uint16_t address)
+{
+    int lo = 0;
+    int hi = map->nblocks - 1;
+    while (lo <= hi)
+    {
+        int mid = (lo + hi) / 2;
+        const BasicBlock8080* b = &map->blocks[mid];
+        if (address < b->start)
+            hi = mid - 1;
+        else if (address >= b->end)
+            lo = mid + 1;
+        else
+            return mid;
+    }
+    return -1;
+}
+
+/*
+Flag liveness using the opcode table's read and write sets. A flag an
+instruction writes is dead if, on every path, something overwrites it
+before anything reads it. Liveness is followed across jumps, branches and
+fallthroughs to a fixed point; calls, returns, PCHL and anything leaving
+the analyzed code count as reading every flag, so the core falls back to
+computing them all there. dead has an entry per address
+(State8080::dead_flags) and is 0 outside the analyzed code.
+
+Interrupts can land between any two instructions, but a handler that
+saves PSW restores the same stale flags, and the code overwrites them.
+
+returns the number of instructions with at least one dead flag
+*/
+static uint8_t LiveOut(const CodeMap8080* map, const uint8_t* live_in, const BasicBlock8080* b)
+{
+    if (b->exit == EXIT_CALL || b->exit == EXIT_RETURN || b->exit == EXIT_INDIRECT ||
+        b->exit == EXIT_END)
+        return FLAGS_ALL;
+
+    uint8_t live = 0;
+    for (int s = 0; s < b->nsucc; s++)
+    {
+        int i = FindBlock(map, b->succ[s]);
+        if (i < 0 || map->blocks[i].start != b->succ[s])
+            return FLAGS_ALL;
+        live |= live_in[i];
+    }
+    return live;
+}
+
+static uint8_t BlockLiveness(const BasicBlock8080* b, const unsigned char* memory, uint8_t live,
+                             uint8_t* dead)
+{
+    static uint16_t insns[0x10000];
+    int n = 0;
+    for (uint32_t pc = b->start; pc < b->end; pc += opinfo8080[memory[pc]].length)
+        insns[n++] = pc;
+
+    while (n-- > 0)
+    {
+        const OpInfo8080* info = &opinfo8080[memory[insns[n]]];
+        if (dead != NULL)
+            dead[insns[n]] = info->flags_written & ~live;
+        live = (live & ~info->flags_written) | info->flags_read;
+    }
+    return live;
+}
+
+int FindDeadFlags(const CodeMap8080* map, const unsigned char* memory, uint8_t* dead)
+{
+    static uint8_t live_in[MAX_BLOCKS];
+
+    // live sets only grow from nothing, so this settles
+    memset(live_in, 0, sizeof(live_in));
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (int i = map->nblocks - 1; i >= 0; i--)
+        {
+            const BasicBlock8080* b = &map->blocks[i];
+            uint8_t live = BlockLiveness(b, memory, LiveOut(map, live_in, b), NULL);
+            if (live != live_in[i])
+            {
+                live_in[i] = live;
+                changed = 1;
+            }
+        }
+    }
+
+    memset(dead, 0, 0x10000);
+    for (int i = 0; i < map->nblocks; i++)
+    {
+        const BasicBlock8080* b = &map->blocks[i];
+        BlockLiveness(b, memory, LiveOut(map, live_in, b), dead);
+    }
+
+    int found = 0;
+    for (int i = 0; i < 0x10000; i++)
+        if (dead[i])
+            found++;
+    return found;
+}
+
+static const char* exitnames[] = {
+    "fallthrough", "jump", "branch", "call", "return", "indirect", "halt", "end",
+};
+
+/*
+Prints code as assembly, block by block, and everything that was never
+reached as DB lines.
+*/
+void WriteListing(const CodeMap8080* map, const unsigned char* memory, FILE* out)
+{
+    char text[DISASSEMBLY_MAX];
+    uint32_t pc = 0;
+    while (pc < map->size)
+    {
+        if (map->flags[pc] & CODE_INSN)
+        {
+            if (map->flags[pc] & CODE_LEADER)
+                fprintf(out, "\n%04x:\n", pc);
+            int length = Format8080Op(&memory[pc], text);
+            fprintf(out, "    %04x  ", pc);
+            for (int i = 0; i < 3; i++)
+            {
+                if (i < length)
+                    fprintf(out, "%02x ", memory[pc + i]);
+                else
+                    fprintf(out, "   ");
+            }
+            fprintf(out, " %s\n", text);
+            pc += length;
+            continue;
+        }
+
+        // a run of data, 8 bytes to a line
+        fprintf(out, "    %04x  DB     ", pc);
+        int n = 0;
+        while (pc < map->size && !(map->flags[pc] & CODE_INSN) && n < 8)
+        {
+            fprintf(out, "%s$%02x", n ? "," : "", memory[pc]);
+            pc++;
+            n++;
+        }
+        fprintf(out, "\n");
+    }
+}
+
+void WriteDot(const CodeMap8080* map, FILE* out)
+{
+    fprintf(out, "digraph cfg {\n");
+    fprintf(out, "    node [shape=box fontname=monospace];\n");
+    for (int i = 0; i < map->nblocks; i++)
+    {
+        const BasicBlock8080* b = &map->blocks[i];
+        fprintf(out, "    b%04x [label=\"%04x-%04x\\n%s\"];\n", b->start, b->start, b->end - 1, exitnames[b->exit]);
+        for (int s = 0; s < b->nsucc; s++)
+        {
+            const char* style = "";
+            if (b->exit == EXIT_CALL && s == 0)
+                style = " [style=dashed]";
+            else if (b->nsucc == 2 && s == 1)
+                style = " [color=gray]";
+            fprintf(out, "    b%04x -> b%04x%s;\n", b->start, b->succ[s], style);
+        }
+    }
+    fprintf(out, "}\n");
+}
+
+void WriteJson(const CodeMap8080* map, FILE* out)
+{
+    int code = 0;
+    for (uint32_t i = 0; i < map->size; i++)
+        if (map->flags[i] & (CODE_INSN | CODE_OPERAND))
+            code++;
+
+    fprintf(out, "{\"size\": %u, \"code_bytes\": %d, \"blocks\": [\n", map->size, code);
+    for (int i = 0; i < map->nblocks; i++)
+    {
+        const BasicBlock8080* b = &map->blocks[i];
+        fprintf(out, "  {\"start\": %u, \"end\": %u, \"exit\": \"%s\", \"succ\": [", b->start, b->end, exitnames[b->exit]);
+        for (int s = 0; s < b->nsucc; s++)
+            fprintf(out, "%s%u", s ? ", " : "", b->succ[s]);
+        fprintf(out, "]}%s\n", i + 1 < map->nblocks ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
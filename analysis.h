@@ -0,0 +1,57 @@
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <cstdint>
+#include <cstdio>
+
+// Recursive descent over a ROM image: starting from the entry points, follow
+// every jump, call and RST target to find which bytes are code, split the
+// code into basic blocks and record the edges between them. The per-address
+// flags are what a predecode cache or recompiler wants for block boundaries.
+
+#define MAX_BLOCKS 4096
+
+// per-address flags
+#define CODE_INSN       0x01    // first byte of an instruction
+#define CODE_OPERAND    0x02    // operand byte of an instruction
+#define CODE_LEADER     0x04    // a basic block starts here
+#define CODE_OVERLAP    0x08    // reached as both operand and instruction start
+
+// how a basic block ends
+enum BlockExit8080 {
+    EXIT_FALLTHROUGH,           // runs into the next block's leader
+    EXIT_JUMP,
+    EXIT_BRANCH,                // Jcc, taken edge plus fallthrough
+    EXIT_CALL,                  // CALL/Ccc/RST, callee plus return site
+    EXIT_RETURN,                // RET, or Rcc with a fallthrough
+    EXIT_INDIRECT,              // PCHL, target unknown
+    EXIT_HALT,
+    EXIT_END,                   // ran off the end of the image
+};
+
+struct BasicBlock8080 {
+    uint16_t start;
+    uint16_t end;               // one past the last byte
+    uint16_t last;              // address of the final instruction
+    uint8_t exit;
+    uint8_t nsucc;
+    uint16_t succ[2];           // taken/callee first, fallthrough second
+};
+
+struct CodeMap8080 {
+    uint8_t flags[0x10000];
+    BasicBlock8080 blocks[MAX_BLOCKS];
+    int nblocks;
+    uint32_t size;
+};
+
+int AnalyzeCode(const unsigned char* memory, uint32_t size, const uint16_t* entries, int nentries,
+                CodeMap8080* map);
+int FindBlock(const CodeMap8080* map, uint16_t address);
+int FindDeadFlags(const CodeMap8080* map, const unsigned char* memory, uint8_t* dead);
+
+void WriteListing(const CodeMap8080* map, const unsigned char* memory, FILE* out);
+void WriteDot(const CodeMap8080* map, FILE* out);
+void WriteJson(const CodeMap8080* map, FILE* out);
+
+#endif
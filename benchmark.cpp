@@ -0,0 +1,519 @@
+/*
+Throughput benchmarks for the emulator. Results go to stdout (or -o file)
+as JSON, or CSV with --csv, one record per metric so runs from different
+commits can be diffed or loaded straight into a spreadsheet.
+
+Build with the trace compiled out, otherwise printf is all you measure:
+
+    g++ -O2 -pthread -DPRINTOPS=0 benchmark.cpp 8080cpu.cpp machine.cpp disassembler.cpp analysis.cpp \
+        observation.cpp stats.cpp romset.cpp statefile.cpp env.cpp -o benchmark
+
+usage: benchmark [-n frames] [-o file] [--csv] [rom]
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+#include "functions.h"
+#include "i8080.h"
+#include "machine.h"
+#include "analysis.h"
+#include "observation.h"
+#include "romset.h"
+#include "statefile.h"
+#include "env.h"
+
+#define MAX_RESULTS 512
+#define OPCODE_ITERATIONS 200000
+#define RENDER_ITERATIONS 2000
+#define DISASSEMBLE_PASSES 50
+#define ENV_MACHINES 16
+#define ENV_FRAMESKIP 4
+
+// synthetic instruction streams sit well clear of the ROM and the stack;
+// operands point at scratch RAM so stores can't clobber the code
+#define SCRATCH_CODE 0x2000
+#define SCRATCH_DATA 0x3000
+
+struct Result {
+    const char* bench;
+    char metric[32];
+    double value;
+    const char* unit;
+};
+
+static Result results[MAX_RESULTS];
+static int nresults = 0;
+
+static void Record(const char* bench, const char* metric, double value, const char* unit)
+{
+    if (nresults == MAX_RESULTS)
+        return;
+    Result* r = &results[nresults++];
+    r->bench = bench;
+    snprintf(r->metric, sizeof(r->metric), "%s", metric);
+    r->value = value;
+    r->unit = unit;
+}
+
+// the benchmarks are meaningless without the ROM, so give up on the spot
+static State8080* LoadRom(const char* rom)
+{
+    State8080* state = Init8080();
+    int status = state != NULL ? ReadFileIntoMemoryAt(state, rom, 0) : STATUS_NO_MEMORY;
+    if (status != STATUS_OK)
+    {
+        printf("error: %s: %s\n", rom, StatusString8080(status));
+        exit(1);
+    }
+    return state;
+}
+
+static double Seconds(std::chrono::steady_clock::time_point start)
+{
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    return d.count();
+}
+
+// with dead_flags set the core skips flag work the ROM never looks at;
+// with skip set every skip-th frame is rendered, as a display would
+static void BenchInvaders(const char* bench, const char* rom, int frames, int dead_flags, int skip)
+{
+    State8080* state = LoadRom(rom);
+    if (dead_flags)
+    {
+        static CodeMap8080 map;
+        static uint8_t dead[0x10000];
+        uint16_t entries[] = {0x0000, 0x0008, 0x0010};
+        AnalyzeCode(state->memory, ROM_SIZE, entries, 3, &map);
+        Record(bench, "dead_flag_insns", FindDeadFlags(&map, state->memory, dead), "insns");
+        state->dead_flags = dead;
+    }
+
+    static uint8_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+    FrameSkip8080 frameskip;
+    InitFrameSkip(&frameskip, skip);
+
+    int completed = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (completed < frames && RunFrame(state) == 0)
+    {
+        if (skip > 0 && WantFrame(&frameskip))
+            RenderFrame(state->memory, framebuffer);
+        completed++;
+    }
+    double secs = Seconds(start);
+
+    Record(bench, "frames", completed, "frames");
+    Record(bench, "halted", Stopped8080(state), "bool");
+    Record(bench, "cycles", (double) state->cycles, "cycles");
+    Record(bench, "seconds", secs, "s");
+    Record(bench, "emulated_mhz", state->cycles / secs / 1e6, "MHz");
+    Record(bench, "mips", state->instructions / secs / 1e6, "MIPS");
+    Record(bench, "fps", completed / secs, "frames/s");
+    Destroy8080(state);
+}
+
+// a host frame shows the frame ahead frames past the real one
+static void BenchRunAhead(const char* bench, const char* rom, int frames, int ahead_frames)
+{
+    State8080* state = LoadRom(rom);
+    static Cabinet8080 cabinet;
+    cabinet = Cabinet8080();
+    AttachCabinet(state, &cabinet);
+    static RunAhead8080 ahead;
+    InitRunAhead(&ahead, ahead_frames);
+
+    for (int i = 0; i < frames && BeginRunAhead(&ahead, state) == 0; i++)
+        EndRunAhead(&ahead, state);
+
+    Record(bench, "host_frames", (double) ahead.host_frames, "frames");
+    Record(bench, "ns_per_host_frame", (double) ahead.total_ns / ahead.host_frames, "ns");
+    Record(bench, "worst_headroom_ns", (double) ahead.worst_headroom_ns, "ns");
+    Record(bench, "late_frames", (double) ahead.late_frames, "frames");
+    Destroy8080(state);
+}
+
+// checkpoints at a point in attract mode, raw and run-length encoded:
+// the cost of writing one, and of opening and loading one back
+static void BenchStateFile(const char* rom, int frames)
+{
+    State8080* state = LoadRom(rom);
+    static Cabinet8080 cabinet;
+    cabinet = Cabinet8080();
+    AttachCabinet(state, &cabinet);
+    for (int i = 0; i < frames && RunFrame(state) == 0; i++)
+        ;
+    RomHash8080 hash;
+    HashRom(state->memory, &hash);
+
+    char filename[] = "/tmp/benchmarkXXXXXX";
+    int fd = mkstemp(filename);
+    if (fd < 0)
+        return;
+    close(fd);
+    const int writes = 1000;
+    for (int compress = 0; compress < 2; compress++)
+    {
+        const char* bench = compress ? "statefile_rle" : "statefile";
+        auto t = std::chrono::steady_clock::now();
+        int status = STATUS_OK;
+        for (int i = 0; i < writes && status == STATUS_OK; i++)
+            status = WriteStateFile(filename, state, &hash, compress);
+        if (status != STATUS_OK)
+            break;
+        Record(bench, "write_us", Seconds(t) * 1e6 / writes, "us");
+
+        StateFile8080 file;
+        t = std::chrono::steady_clock::now();
+        for (int i = 0; i < writes && status == STATUS_OK; i++)
+        {
+            if ((status = OpenStateFile(filename, &file)) == STATUS_OK)
+            {
+                status = LoadStateFile(&file, state, &hash);
+                CloseStateFile(&file);
+            }
+        }
+        Record(bench, "load_us", Seconds(t) * 1e6 / writes, "us");
+        OpenStateFile(filename, &file);
+        Record(bench, "bytes", (double) file.size, "bytes");
+        CloseStateFile(&file);
+    }
+    unlink(filename);
+    Destroy8080(state);
+}
+
+// what starting a machine costs: mapping and checking the set once, then
+// one copy per machine
+static void BenchRomSet(const char* rom)
+{
+    static RomSet8080 set;
+    const int opens = 1000;
+    auto t = std::chrono::steady_clock::now();
+    int status = STATUS_OK;
+    for (int i = 0; i < opens && status == STATUS_OK; i++)
+    {
+        status = OpenRomSet(rom, 0, &set);
+        CloseRomSet(&set);
+    }
+    double secs = Seconds(t);
+    if (status != STATUS_OK)
+        return;
+    Record("romset", "open_us", secs * 1e6 / opens, "us");
+
+    OpenRomSet(rom, 0, &set);
+    Record("romset", "verified", set.verified, "bool");
+    State8080* state = Init8080();
+    t = std::chrono::steady_clock::now();
+    for (int i = 0; i < RENDER_ITERATIONS; i++)
+        InstallRom(&set, state);
+    Record("romset", "install_ns", Seconds(t) * 1e9 / RENDER_ITERATIONS, "ns");
+    Destroy8080(state);
+    CloseRomSet(&set);
+
+#if EMBED_ROM
+    // the compiled-in ROM has to run exactly like the file: same RAM after
+    // the same frames
+    uint32_t crc[2];
+    for (int embedded = 0; embedded < 2; embedded++)
+    {
+        state = Init8080();
+        embedded ? OpenEmbeddedRom(&set) : OpenRomSet(rom, 0, &set);
+        InstallRom(&set, state);
+        CloseRomSet(&set);
+        static Cabinet8080 cabinet;
+        cabinet = Cabinet8080();
+        AttachCabinet(state, &cabinet);
+        for (int i = 0; i < 600 && RunFrame(state) == 0; i++)
+            ;
+        crc[embedded] = Crc32(state->memory, 0x10000);
+        Destroy8080(state);
+    }
+    Record("romset", "embedded_matches_file", crc[0] == crc[1], "bool");
+
+    t = std::chrono::steady_clock::now();
+    for (int i = 0; i < opens; i++)
+    {
+        OpenEmbeddedRom(&set);
+        CloseRomSet(&set);
+    }
+    Record("romset", "embedded_open_us", Seconds(t) * 1e6 / opens, "us");
+#endif
+}
+
+static void BenchOpcodes()
+{
+    State8080* state = Init8080();
+    uint8_t* memory = state->memory;
+
+    State8080 start = *state;
+    start.a = 0x5a;
+    start.b = start.d = start.h = SCRATCH_DATA >> 8;
+    start.c = start.e = start.l = 0x10;
+    start.sp = 0x3f00;
+
+    for (int op = 0; op < 256; op++)
+    {
+        memory[SCRATCH_CODE] = op;
+        memory[SCRATCH_CODE + 1] = SCRATCH_DATA & 0xff;
+        memory[SCRATCH_CODE + 2] = SCRATCH_DATA >> 8;
+        start.pc = SCRATCH_CODE;
+
+        // HLT with interrupts off stops the machine, nothing to time
+        *state = start;
+        if (Emulate8080p(state))
+            continue;
+
+        auto t = std::chrono::steady_clock::now();
+        for (int i = 0; i < OPCODE_ITERATIONS; i++)
+        {
+            *state = start;
+            Emulate8080p(state);
+        }
+        double secs = Seconds(t);
+
+        char metric[32];
+        snprintf(metric, sizeof(metric), "op_%02x", op);
+        Record("opcode", metric, secs * 1e9 / OPCODE_ITERATIONS, "ns");
+    }
+    Destroy8080(state);
+}
+
+static void BenchRender(const char* rom, int frames)
+{
+    // render whatever the game has drawn after a short run so the
+    // picture isn't blank
+    State8080* state = LoadRom(rom);
+    for (int i = 0; i < frames && RunFrame(state) == 0; i++)
+        ;
+
+    static uint8_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+    auto t = std::chrono::steady_clock::now();
+    for (int i = 0; i < RENDER_ITERATIONS; i++)
+        RenderFrame(state->memory, framebuffer);
+    double secs = Seconds(t);
+
+    Record("render", "frames_per_second", RENDER_ITERATIONS / secs, "frames/s");
+    Record("render", "ns_per_frame", secs * 1e9 / RENDER_ITERATIONS, "ns");
+    Destroy8080(state);
+}
+
+static void BenchDisassembler(const char* rom)
+{
+    State8080* state = LoadRom(rom);
+
+    // Disassemble8080Op prints as it goes, so point stdout at /dev/null
+    // for the duration
+    fflush(stdout);
+    int saved = dup(1);
+    int devnull = open("/dev/null", O_WRONLY);
+    dup2(devnull, 1);
+
+    long count = 0;
+    auto t = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < DISASSEMBLE_PASSES; pass++)
+    {
+        int pc = 0;
+        while (pc < 0x2000)
+        {
+            pc += Disassemble8080Op(state->memory, pc);
+            count++;
+        }
+    }
+    fflush(stdout);
+    double secs = Seconds(t);
+
+    dup2(saved, 1);
+    close(saved);
+    close(devnull);
+
+    Record("disassembler", "instructions_per_second", count / secs, "instr/s");
+    Record("disassembler", "ns_per_instruction", secs * 1e9 / count, "ns");
+
+    // the buffer based decoder and formatter, which is what trace and
+    // profile tooling calls
+    char text[DISASSEMBLY_MAX];
+    Instruction8080 op;
+    uint64_t checksum = 0;
+    count = 0;
+    t = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < DISASSEMBLE_PASSES; pass++)
+    {
+        int pc = 0;
+        while (pc < 0x2000)
+        {
+            pc += Decode8080Op(&state->memory[pc], &op);
+            checksum += op.operand;
+            count++;
+        }
+    }
+    secs = Seconds(t);
+    Record("decode", "instructions_per_second", count / secs, "instr/s");
+    Record("decode", "ns_per_instruction", secs * 1e9 / count, "ns");
+
+    count = 0;
+    t = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < DISASSEMBLE_PASSES; pass++)
+    {
+        int pc = 0;
+        while (pc < 0x2000)
+        {
+            pc += Format8080Op(&state->memory[pc], text);
+            checksum += text[0];
+            count++;
+        }
+    }
+    secs = Seconds(t);
+    Record("format", "instructions_per_second", count / secs, "instr/s");
+    Record("format", "ns_per_instruction", secs * 1e9 / count, "ns");
+    // keeps the loops above from being optimized away
+    Record("decode", "checksum", (double) checksum, "");
+    Destroy8080(state);
+}
+
+static void WriteJson(FILE* out)
+{
+    fprintf(out, "{\"results\": [\n");
+    for (int i = 0; i < nresults; i++)
+        fprintf(out, "  {\"bench\": \"%s\", \"metric\": \"%s\", \"value\": %.6g, \"unit\": \"%s\"}%s\n",
+                results[i].bench, results[i].metric, results[i].value, results[i].unit,
+                i + 1 < nresults ? "," : "");
+    fprintf(out, "]}\n");
+}
+
+static void WriteCsv(FILE* out)
+{
+    fprintf(out, "bench,metric,value,unit\n");
+    for (int i = 0; i < nresults; i++)
+        fprintf(out, "%s,%s,%.6g,%s\n", results[i].bench, results[i].metric, results[i].value, results[i].unit);
+}
+
+static void BenchObservation(const char* rom, int frames)
+{
+    State8080* state = LoadRom(rom);
+    static Cabinet8080 cabinet;
+    AttachCabinet(state, &cabinet);
+    for (int i = 0; i < frames && RunFrame(state) == 0; i++)
+        ;
+
+    static ObservationKernel8080 kernel;
+    static uint8_t out[OBSERVATION_MAX * OBSERVATION_MAX];
+    const char* names[] = {"84x84_average", "84x84_max"};
+    for (int pool = POOL_AVERAGE; pool <= POOL_MAX; pool++)
+    {
+        InitObservation(&kernel, 84, 84, pool);
+        auto t = std::chrono::steady_clock::now();
+        for (int i = 0; i < RENDER_ITERATIONS; i++)
+            ExtractObservation(&kernel, &state->memory[VRAM_START], out);
+        double secs = Seconds(t);
+
+        char metric[32];
+        snprintf(metric, sizeof(metric), "%s_ns", names[pool]);
+        Record("observation", metric, secs * 1e9 / RENDER_ITERATIONS, "ns");
+    }
+    Destroy8080(state);
+}
+
+static void BenchEnv(const char* bench, const char* rom, int frames, int observation)
+{
+    int nthreads = std::thread::hardware_concurrency();
+    int status;
+    InvadersEnv* env = CreateEnv(ENV_MACHINES, ENV_FRAMESKIP, nthreads, rom, &status);
+    if (env == NULL)
+    {
+        printf("error: %s: %s\n", rom, StatusString8080(status));
+        exit(1);
+    }
+    if (observation)
+        SetEnvObservation(env, 84, 84, POOL_AVERAGE, 4);
+
+    // a fixed pseudo-random policy, so runs are comparable
+    uint8_t actions[ENV_MACHINES];
+    uint32_t seed = 1;
+    int steps = frames / ENV_FRAMESKIP;
+    double reward = 0;
+    int dones = 0;
+    auto t = std::chrono::steady_clock::now();
+    for (int s = 0; s < steps; s++)
+    {
+        for (int i = 0; i < ENV_MACHINES; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            actions[i] = (seed >> 16) % ACTION_COUNT;
+        }
+        StepEnv(env, actions);
+        for (int i = 0; i < ENV_MACHINES; i++)
+        {
+            reward += env->rewards[i];
+            dones += env->dones[i];
+        }
+    }
+    double secs = Seconds(t);
+
+    Record(bench, "machines", ENV_MACHINES, "machines");
+    Record(bench, "threads", nthreads, "threads");
+    Record(bench, "steps_per_second", steps / secs, "steps/s");
+    Record(bench, "frames_per_second", (double) steps * ENV_MACHINES * ENV_FRAMESKIP / secs, "frames/s");
+    Record(bench, "reward", reward, "points");
+    Record(bench, "episodes", dones, "episodes");
+
+    // the env's own counters, summed over the batch
+    Stats8080 total;
+    EnvStats(env, &total);
+    Record(bench, "mips", total.instructions / secs / 1e6, "MIPS");
+    Record(bench, "cpu_ns_per_frame", (double) total.cpu_ns / total.frames, "ns");
+    Record(bench, "render_ns_per_frame", (double) total.render_ns / total.frames, "ns");
+    DestroyEnv(env);
+}
+
+int main(int argc, char** argv)
+{
+    const char* rom = "invaders";
+    const char* outname = NULL;
+    int frames = 600;
+    int csv = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+            outname = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0)
+            csv = 1;
+        else
+            rom = argv[i];
+    }
+
+    BenchInvaders("invaders", rom, frames, 0, 0);
+    BenchInvaders("invaders_dead_flags", rom, frames, 1, 0);
+    BenchInvaders("invaders_render", rom, frames, 1, 1);
+    BenchInvaders("invaders_render_skip4", rom, frames, 1, 4);
+    BenchRunAhead("run_ahead_2", rom, frames, 2);
+    BenchRomSet(rom);
+    BenchStateFile(rom, frames);
+    BenchOpcodes();
+    BenchRender(rom, frames);
+    BenchDisassembler(rom);
+    BenchObservation(rom, frames);
+    BenchEnv("env", rom, frames, 0);
+    BenchEnv("env_84x84x4", rom, frames, 1);
+
+    FILE* out = stdout;
+    if (outname != NULL && (out = fopen(outname, "w")) == NULL)
+    {
+        printf("error: Couldn't open %s\n", outname);
+        return 1;
+    }
+    if (csv)
+        WriteCsv(out);
+    else
+        WriteJson(out);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
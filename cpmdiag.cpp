@@ -0,0 +1,139 @@
+/*
+Runs CP/M 8080 diagnostic programs (cpudiag, 8080PRE, 8080EXM, ...) against
+the core with just enough of CP/M faked to keep them happy, and reports
+pass/fail and how long each took. 8080EXM runs billions of instructions,
+so this is also the CPU-heavy benchmark.
+
+    g++ -O2 -DPRINTOPS=0 cpmdiag.cpp 8080cpu.cpp disassembler.cpp -o cpmdiag
+
+usage: cpmdiag [-q] [-c cycles] file.com...
+
+-c gives up on a program that hasn't finished after that many cycles
+(default 100 billion, 8080EXM needs about 23 billion) and fails it, so a
+diagnostic stuck in a loop can't hang the run.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <chrono>
+#include "functions.h"
+#include "i8080.h"
+
+#define TPA_START   0x0100      // CP/M loads .COM files here
+#define BDOS        0x0005      // programs CALL 5 for console output
+#define TPA_TOP     0xf000      // what we claim the top of memory is
+#define MAX_OUTPUT  65536
+#define MAX_CYCLES  100000000000ull
+
+static char output[MAX_OUTPUT];
+static int outlen;
+static int quiet;
+static uint64_t max_cycles = MAX_CYCLES;
+
+static void ConsoleOut(char c)
+{
+    if (outlen < MAX_OUTPUT - 1)
+        output[outlen++] = c;
+    if (!quiet)
+        putchar(c);
+}
+
+// The only BDOS calls the diagnostics make: 2 prints E, 9 prints the
+// '$' terminated string at DE. The RET at 0x0005 returns to the caller.
+static void Bdos(State8080* state)
+{
+    if (state->c == 2)
+        ConsoleOut(state->e);
+    else if (state->c == 9)
+    {
+        uint16_t offset = state->de;
+        while (state->memory[offset] != '$')
+            ConsoleOut(state->memory[offset++]);
+    }
+}
+
+/*
+Loads and runs one program until it jumps to 0 (warm boot), the core
+stops or it runs out of cycles.
+
+returns 1 if it finished without reporting an error
+*/
+static int RunCom(const char* filename)
+{
+    State8080* state = Init8080();
+    int status = state != NULL ? ReadFileIntoMemoryAt(state, filename, TPA_START) : STATUS_NO_MEMORY;
+    if (status != STATUS_OK)
+    {
+        printf("%s: FAIL, %s\n", filename, StatusString8080(status));
+        Destroy8080(state);
+        return 0;
+    }
+
+    state->memory[0x0000] = 0x76;               // warm boot, we stop here
+    state->memory[BDOS] = 0xc9;                 // RET
+    state->memory[BDOS + 1] = TPA_TOP & 0xff;   // the BDOS jump's operand is
+    state->memory[BDOS + 2] = TPA_TOP >> 8;     // read as the top of memory
+    state->pc = TPA_START;
+    state->sp = TPA_TOP;
+
+    outlen = 0;
+    uint64_t instructions = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (state->pc != 0x0000 && state->cycles < max_cycles)
+    {
+        if (state->pc == BDOS)
+            Bdos(state);
+        if (Emulate8080p(state))
+            break;
+        instructions++;
+    }
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    output[outlen] = '\0';
+
+    int timed_out = state->pc != 0x0000 && !state->halted;
+    int passed = !state->halted && !timed_out && strstr(output, "ERROR") == NULL &&
+                 strstr(output, "FAILED") == NULL;
+    if (state->halted)
+        printf("\n%s: stopped at $%04x\n", filename, state->pc);
+    if (timed_out)
+        printf("\n%s: still running at $%04x after %llu cycles\n", filename, state->pc,
+               (unsigned long long) state->cycles);
+    printf("\n%s: %s, %llu instructions, %llu cycles, %.3fs, %.1f emulated MHz\n",
+           filename, passed ? "PASS" : "FAIL",
+           (unsigned long long) instructions, (unsigned long long) state->cycles,
+           secs.count(), state->cycles / secs.count() / 1e6);
+
+    Destroy8080(state);
+    return passed;
+}
+
+int main(int argc, char** argv)
+{
+    int failed = 0;
+    int ran = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-q") == 0)
+        {
+            quiet = 1;
+            continue;
+        }
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc)
+        {
+            max_cycles = strtoull(argv[++i], NULL, 0);
+            continue;
+        }
+        if (!RunCom(argv[i]))
+            failed++;
+        ran++;
+    }
+    if (ran == 0)
+    {
+        printf("usage: cpmdiag [-q] [-c cycles] file.com...\n");
+        return 2;
+    }
+    return failed != 0;
+}
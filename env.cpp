@@ -0,0 +1,325 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "i8080.h"
+#include "machine.h"
+#include "analysis.h"
+#include "observation.h"
+#include "romset.h"
+#include "env.h"
+
+#define BOOT_FRAMES_MAX     2000    // give up if no game has started by then
+#define COIN_FRAME          60      // the ROM ignores the coin slot while it boots
+
+static const uint8_t action_inputs[ACTION_COUNT] = {
+    0,
+    INPUT_FIRE,
+    INPUT_LEFT,
+    INPUT_RIGHT,
+    INPUT_LEFT | INPUT_FIRE,
+    INPUT_RIGHT | INPUT_FIRE,
+};
+
+static uint32_t Score(const uint8_t* memory)
+{
+    uint16_t bcd = memory[P1_SCORE] | (memory[P1_SCORE + 1] << 8);
+    return ((bcd >> 12) & 0xf) * 1000 + ((bcd >> 8) & 0xf) * 100 + ((bcd >> 4) & 0xf) * 10 + (bcd & 0xf);
+}
+
+static void ResetMachine(InvadersEnv* env, int i)
+{
+    State8080* state = env->machines[i];
+    State8080 live = *state;
+    *state = env->start;
+    state->memory = live.memory;
+    state->io = &env->cabinets[i];
+    // the counters keep counting across games
+    state->cycles = live.cycles;
+    state->instructions = live.instructions;
+    state->interrupts = live.interrupts;
+    memcpy(state->memory, env->start_memory, 0x10000);
+    env->cabinets[i] = env->start_cabinet;
+    env->scores[i] = Score(state->memory);
+}
+
+// Fills machine i's slice of the batch, restarting its frame stack if a
+// new game just began.
+static void Observe(InvadersEnv* env, int i, int restart)
+{
+    const uint8_t* memory = env->machines[i]->memory;
+    uint8_t* slice = &env->observations[i * env->observation_size];
+    if (env->kernel == NULL)
+        RenderFrame(memory, slice);
+    else if (env->stacks == NULL)
+        ExtractObservation(env->kernel, &memory[VRAM_START], slice);
+    else
+    {
+        FrameStack8080* stack = env->stacks[i];
+        uint8_t* slot = NextStackSlot(stack);
+        ExtractObservation(env->kernel, &memory[VRAM_START], slot);
+        if (restart)
+            FillFrameStack(stack, slot);
+        CopyFrameStack(stack, slice);
+    }
+}
+
+static void StepMachine(InvadersEnv* env, int i, uint8_t action)
+{
+    State8080* state = env->machines[i];
+    Stats8080* stats = &env->stats[i];
+    env->cabinets[i].port1 = action < ACTION_COUNT ? action_inputs[action] : 0;
+
+    uint64_t lap = MonotonicNs();
+    int done = 0;
+    for (int f = 0; f < env->frameskip && !done; f++)
+    {
+        done = RunFrame(state) || state->memory[GAME_MODE] == 0;
+        stats->frames++;
+    }
+    Lap(&stats->cpu_ns, &lap);
+
+    // the counter wraps at 9999
+    uint32_t score = Score(state->memory);
+    if (score < env->scores[i])
+        score += 10000;
+    env->rewards[i] = (float) (score - env->scores[i]);
+    env->scores[i] = score % 10000;
+    env->dones[i] = done;
+
+    if (done)
+        ResetMachine(env, i);
+    Observe(env, i, done);
+    Lap(&stats->render_ns, &lap);
+    CollectStats(stats, state);
+}
+
+static void Worker(InvadersEnv* env, int index)
+{
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard(env->lock);
+            env->work.wait(guard, [&] { return env->quitting || env->generation != seen; });
+            if (env->quitting)
+                return;
+            seen = env->generation;
+        }
+
+        for (int i = index; i < env->count; i += env->nthreads)
+            StepMachine(env, i, env->actions[i]);
+
+        std::lock_guard<std::mutex> guard(env->lock);
+        if (--env->running == 0)
+            env->finished.notify_one();
+    }
+}
+
+/*
+Boots one machine, drops a coin and presses start, and keeps the state
+the moment the game begins as the starting point for every episode.
+
+returns STATUS_OK, or STATUS_HALTED if no game got going
+*/
+static int TakeStart(InvadersEnv* env)
+{
+    State8080* state = env->machines[0];
+    Cabinet8080* cabinet = &env->cabinets[0];
+    AttachCabinet(state, cabinet);
+
+    for (int frame = 0; frame < BOOT_FRAMES_MAX; frame++)
+    {
+        if (frame >= COIN_FRAME && frame < COIN_FRAME + 10)
+            cabinet->port1 = INPUT_COIN;
+        else if (frame >= COIN_FRAME + 20)
+            cabinet->port1 = INPUT_P1_START;
+        else
+            cabinet->port1 = 0;
+        if (RunFrame(state))
+            return STATUS_HALTED;
+        if (state->memory[GAME_MODE] == 1)
+        {
+            cabinet->port1 = 0;
+            env->start = *state;
+            memcpy(env->start_memory, state->memory, 0x10000);
+            env->start_cabinet = *cabinet;
+            return STATUS_OK;
+        }
+    }
+    return STATUS_HALTED;
+}
+
+/*
+Makes count machines running rom (a merged file or a split set, see
+romset.h, or NULL for the compiled-in one) that step frameskip frames at a
+time on
+nthreads workers (0 steps them on the calling thread).
+
+returns the environment, reset and ready, or NULL with the reason in status
+*/
+InvadersEnv* CreateEnv(int count, int frameskip, int nthreads, const char* rom, int* status)
+{
+    InvadersEnv* env = new InvadersEnv();
+    env->count = count;
+    env->frameskip = frameskip > 0 ? frameskip : 1;
+    env->nthreads = nthreads < count ? nthreads : count;
+    env->machines = (State8080**) calloc(count, sizeof(State8080*));
+    env->cabinets = (Cabinet8080*) calloc(count, sizeof(Cabinet8080));
+    env->scores = (uint32_t*) calloc(count, sizeof(uint32_t));
+    env->observation_size = SCREEN_WIDTH * SCREEN_HEIGHT;
+    env->observations = (uint8_t*) calloc(count, env->observation_size);
+    env->rewards = (float*) calloc(count, sizeof(float));
+    env->dones = (uint8_t*) calloc(count, 1);
+    env->stats = new Stats8080[count]();
+    env->start_memory = (uint8_t*) calloc(0x10000, 1);
+
+    *status = STATUS_OK;
+    for (int i = 0; i < count && *status == STATUS_OK; i++)
+        if ((env->machines[i] = Init8080()) == NULL)
+            *status = STATUS_NO_MEMORY;
+    RomSet8080 set;
+    if (*status == STATUS_OK &&
+        (*status = rom != NULL ? OpenRomSet(rom, 0, &set) : OpenEmbeddedRom(&set)) == STATUS_OK)
+    {
+        InstallRom(&set, env->machines[0]);
+        CloseRomSet(&set);
+    }
+    if (*status == STATUS_OK)
+    {
+        // all the machines run the same ROM, so they share one analysis
+        CodeMap8080* map = (CodeMap8080*) malloc(sizeof(CodeMap8080));
+        uint16_t entries[] = {0x0000, 0x0008, 0x0010};
+        AnalyzeCode(env->machines[0]->memory, ROM_SIZE, entries, 3, map);
+        FindDeadFlags(map, env->machines[0]->memory, env->dead_flags);
+        free(map);
+        env->machines[0]->dead_flags = env->dead_flags;
+        *status = TakeStart(env);
+    }
+    if (*status != STATUS_OK)
+    {
+        DestroyEnv(env);
+        return NULL;
+    }
+
+    ResetEnv(env);
+    env->threads = new std::thread[env->nthreads];
+    for (int t = 0; t < env->nthreads; t++)
+        env->threads[t] = std::thread(Worker, env, t);
+    return env;
+}
+
+static void FreeObservation(InvadersEnv* env)
+{
+    if (env->stacks != NULL)
+        for (int i = 0; i < env->count; i++)
+            DestroyFrameStack(env->stacks[i]);
+    free(env->stacks);
+    free(env->kernel);
+    env->stacks = NULL;
+    env->kernel = NULL;
+}
+
+/*
+Switches observations to width x height blocks of the picture, pooled by
+pool (see observation.h), and with depth > 1 the last depth of them per
+machine. Resets every machine.
+
+returns 0 if the size is out of range
+*/
+int SetEnvObservation(InvadersEnv* env, int width, int height, int pool, int depth)
+{
+    ObservationKernel8080* kernel = (ObservationKernel8080*) malloc(sizeof(ObservationKernel8080));
+    if (!InitObservation(kernel, width, height, pool))
+    {
+        free(kernel);
+        return 0;
+    }
+    FreeObservation(env);
+    env->kernel = kernel;
+    if (depth > 1)
+    {
+        env->stacks = (FrameStack8080**) calloc(env->count, sizeof(FrameStack8080*));
+        for (int i = 0; i < env->count; i++)
+            env->stacks[i] = CreateFrameStack(depth, width * height);
+    }
+    else
+        depth = 1;
+
+    free(env->observations);
+    env->observation_size = (size_t) width * height * depth;
+    env->observations = (uint8_t*) calloc(env->count, env->observation_size);
+    ResetEnv(env);
+    return 1;
+}
+
+void ResetEnv(InvadersEnv* env)
+{
+    for (int i = 0; i < env->count; i++)
+    {
+        ResetMachine(env, i);
+        Observe(env, i, 1);
+        env->rewards[i] = 0;
+        env->dones[i] = 0;
+    }
+}
+
+// actions has one EnvAction per machine
+void StepEnv(InvadersEnv* env, const uint8_t* actions)
+{
+    if (env->nthreads == 0)
+    {
+        for (int i = 0; i < env->count; i++)
+            StepMachine(env, i, actions[i]);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(env->lock);
+        env->actions = actions;
+        env->running = env->nthreads;
+        env->generation++;
+    }
+    env->work.notify_all();
+
+    std::unique_lock<std::mutex> guard(env->lock);
+    env->finished.wait(guard, [&] { return env->running == 0; });
+}
+
+// Sums every machine's counters; call it between steps.
+void EnvStats(const InvadersEnv* env, Stats8080* total)
+{
+    *total = Stats8080();
+    for (int i = 0; i < env->count; i++)
+        AddStats(total, &env->stats[i]);
+}
+
+void DestroyEnv(InvadersEnv* env)
+{
+    if (env->threads != NULL)
+    {
+        {
+            std::lock_guard<std::mutex> guard(env->lock);
+            env->quitting = 1;
+        }
+        env->work.notify_all();
+        for (int t = 0; t < env->nthreads; t++)
+            env->threads[t].join();
+        delete[] env->threads;
+    }
+    for (int i = 0; i < env->count; i++)
+        Destroy8080(env->machines[i]);
+    free(env->machines);
+    free(env->cabinets);
+    free(env->scores);
+    FreeObservation(env);
+    free(env->observations);
+    free(env->rewards);
+    free(env->dones);
+    delete[] env->stats;
+    free(env->start_memory);
+    delete env;
+}
@@ -0,0 +1,81 @@
+#ifndef ENV_H
+#define ENV_H
+
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "functions.h"
+#include "machine.h"
+#include "observation.h"
+#include "stats.h"
+
+// A batch of Space Invaders machines for training agents. StepEnv takes
+// one action per machine, runs every machine frameskip frames with that
+// action held, split across worker threads, and leaves the results in
+// flat arrays indexed by machine:
+//
+//   observations   count x observation_size gray8, by default the whole
+//                  SCREEN_HEIGHT x SCREEN_WIDTH picture rendered straight
+//                  from each machine's VRAM into its slice; after
+//                  SetEnvObservation, depth downsampled frames, oldest
+//                  first
+//   rewards        points scored during the step
+//   dones          1 if the game ended; that machine has already been
+//                  reset, and its observation is the new game's
+//
+// Every game starts from one snapshot taken right after the first
+// machine's coin and start, so a reset is a copy, not a boot.
+
+enum EnvAction {
+    ACTION_NOOP,
+    ACTION_FIRE,
+    ACTION_LEFT,
+    ACTION_RIGHT,
+    ACTION_LEFT_FIRE,
+    ACTION_RIGHT_FIRE,
+    ACTION_COUNT,
+};
+
+struct InvadersEnv {
+    int count;
+    int frameskip;
+    State8080** machines;
+    Cabinet8080* cabinets;
+    uint32_t* scores;           // each game's score so far, in points
+
+    uint8_t* observations;
+    size_t observation_size;    // bytes per machine
+    ObservationKernel8080* kernel;  // NULL for full size pictures
+    FrameStack8080** stacks;    // per machine, NULL without frame stacking
+    float* rewards;
+    uint8_t* dones;
+    Stats8080* stats;           // per machine, written only by its worker
+
+    // what a reset copies back
+    State8080 start;
+    uint8_t* start_memory;
+    Cabinet8080 start_cabinet;
+    uint8_t dead_flags[0x10000];
+
+    // workers wait for generation to move on, do their share of the
+    // machines, and the last one out wakes StepEnv
+    int nthreads;
+    std::thread* threads;
+    std::mutex lock;
+    std::condition_variable work;
+    std::condition_variable finished;
+    uint64_t generation;
+    int running;
+    int quitting;
+    const uint8_t* actions;
+};
+
+InvadersEnv* CreateEnv(int count, int frameskip, int nthreads, const char* rom, int* status);
+int SetEnvObservation(InvadersEnv* env, int width, int height, int pool, int depth);
+void ResetEnv(InvadersEnv* env);
+void StepEnv(InvadersEnv* env, const uint8_t* actions);
+void EnvStats(const InvadersEnv* env, Stats8080* total);
+void DestroyEnv(InvadersEnv* env);
+
+#endif
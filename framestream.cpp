@@ -0,0 +1,103 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "framestream.h"
+
+// Consumer side: render and write whatever is in the ring, nap when it's
+// empty, and finish once the producer has closed and the ring is drained.
+static void WriteFrames(FrameStream8080* stream)
+{
+    for (;;)
+    {
+        uint32_t tail = stream->tail.load(std::memory_order_relaxed);
+        if (tail == stream->head.load(std::memory_order_acquire))
+        {
+            if (stream->closing.load(std::memory_order_acquire) &&
+                tail == stream->head.load(std::memory_order_acquire))
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        // a repeat writes the picture already in framebuffer again
+        const StreamSlot* slot = &stream->slots[tail & (STREAM_SLOTS - 1)];
+        if (!slot->repeat)
+            RenderVram(slot->vram, stream->framebuffer);
+        stream->tail.store(tail + 1, std::memory_order_release);
+
+        if (stream->format == STREAM_Y4M)
+            fputs("FRAME\n", stream->out);
+        fwrite(stream->framebuffer, 1, sizeof(stream->framebuffer), stream->out);
+    }
+    fflush(stream->out);
+}
+
+/*
+Opens filename ("-" for stdout) and starts the writer thread. With wait
+set, PushFrame waits for the writer when the ring is full. skip is how
+many emulated frames each pushed one stands for, so Y4M players get the
+right speed.
+
+returns NULL if the file couldn't be opened
+*/
+FrameStream8080* OpenFrameStream(const char* filename, int format, int wait, int skip)
+{
+    FILE* out = strcmp(filename, "-") == 0 ? stdout : fopen(filename, "wb");
+    if (out == NULL)
+        return NULL;
+    if (format == STREAM_Y4M)
+        fprintf(out, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 Cmono\n",
+                SCREEN_WIDTH, SCREEN_HEIGHT, FRAMES_PER_SECOND, skip > 0 ? skip : 1);
+
+    FrameStream8080* stream = new FrameStream8080();
+    stream->out = out;
+    stream->format = format;
+    stream->wait = wait;
+    stream->writer = std::thread(WriteFrames, stream);
+    return stream;
+}
+
+/*
+Queues the frame currently in memory's VRAM.
+
+returns 1 if the frame was queued, 0 if the ring was full and it was dropped
+*/
+int PushFrame(FrameStream8080* stream, const uint8_t* memory)
+{
+    const uint8_t* vram = &memory[VRAM_START];
+    uint32_t head = stream->head.load(std::memory_order_relaxed);
+    while (stream->wait && head - stream->tail.load(std::memory_order_acquire) == STREAM_SLOTS)
+        std::this_thread::yield();
+    if (head - stream->tail.load(std::memory_order_acquire) == STREAM_SLOTS)
+    {
+        stream->dropped++;
+        return 0;
+    }
+
+    StreamSlot* slot = &stream->slots[head & (STREAM_SLOTS - 1)];
+    slot->repeat = stream->have_last && memcmp(vram, stream->last, VRAM_SIZE) == 0;
+    if (slot->repeat)
+        stream->repeats++;
+    else
+    {
+        memcpy(slot->vram, vram, VRAM_SIZE);
+        memcpy(stream->last, vram, VRAM_SIZE);
+        stream->have_last = 1;
+    }
+    stream->frames++;
+    stream->head.store(head + 1, std::memory_order_release);
+    return 1;
+}
+
+// Waits for the writer to catch up, then closes the output.
+void CloseFrameStream(FrameStream8080* stream)
+{
+    stream->closing.store(1, std::memory_order_release);
+    stream->writer.join();
+    if (stream->out != stdout)
+        fclose(stream->out);
+    delete stream;
+}
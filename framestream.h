@@ -0,0 +1,55 @@
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include <thread>
+#include "machine.h"
+
+// Streams every frame to a file or stdout as Y4M (mono) or raw gray8
+// video. The emulator only copies VRAM into a ring; rendering, encoding
+// and the writes happen on a background thread, so a slow disk or pipe
+// never stalls emulation. If the writer falls a whole ring behind, frames
+// are dropped and counted rather than waited for, unless the stream was
+// opened to wait: a headless run going flat out produces frames faster
+// than any disk takes them and wants all of them. A frame whose VRAM
+// hasn't changed goes through the ring as a repeat with no copy, and the
+// writer sends the previous picture again.
+
+#define STREAM_SLOTS    64          // power of two
+
+enum StreamFormat8080 {
+    STREAM_Y4M,
+    STREAM_RAW,                     // SCREEN_WIDTH x SCREEN_HEIGHT gray8, no headers
+};
+
+struct StreamSlot {
+    uint8_t repeat;                 // same picture as the frame before it
+    uint8_t vram[VRAM_SIZE];
+};
+
+// Single producer (the emulator), single consumer (the writer thread).
+// head is only written by the producer and tail by the consumer.
+struct FrameStream8080 {
+    StreamSlot slots[STREAM_SLOTS];
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    std::atomic<int> closing;
+    std::thread writer;
+    FILE* out;
+    int format;
+    int wait;                       // PushFrame waits for room instead of dropping
+    uint8_t last[VRAM_SIZE];        // producer's copy of the last VRAM pushed
+    int have_last;
+    uint64_t frames;
+    uint64_t repeats;
+    uint64_t dropped;
+    uint8_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];     // the writer's
+};
+
+FrameStream8080* OpenFrameStream(const char* filename, int format, int wait, int skip);
+int PushFrame(FrameStream8080* stream, const uint8_t* memory);
+void CloseFrameStream(FrameStream8080* stream);
+
+#endif
@@ -1,6 +1,104 @@
 #ifndef PLAYER_H    // To make sure you don't declare the function more than once by including the header multiple times.
 #define PLAYER_H
 
+#include <cstdint>
+
+// The flags sit in their PSW bit positions (S Z 0 AC 0 P 1 CY) so PUSH and
+// POP PSW move the byte as is. GCC and Clang allocate bit-fields in byte
+// order, hence the two layouts.
+struct ConditionCodes {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    uint8_t s:1;
+    uint8_t z:1;
+    uint8_t pad5:1;
+    uint8_t ac:1;
+    uint8_t pad3:1;
+    uint8_t p:1;
+    uint8_t one:1;
+    uint8_t cy:1;
+#else
+    uint8_t cy:1;
+    uint8_t one:1;
+    uint8_t p:1;
+    uint8_t pad3:1;
+    uint8_t ac:1;
+    uint8_t pad5:1;
+    uint8_t z:1;
+    uint8_t s:1;
+#endif
+};
+
+// A register pair, addressable as its two 8 bit halves or as one 16 bit
+// value, so nothing has to shift and or them together.
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define REGISTER_PAIR(hi, lo, pair) union { struct { uint8_t hi; uint8_t lo; }; uint16_t pair; }
+#else
+#define REGISTER_PAIR(hi, lo, pair) union { struct { uint8_t lo; uint8_t hi; }; uint16_t pair; }
+#endif
+
+struct Profile8080;
+struct CallProfile8080;
+struct MemoryHeatmap8080;
+
+struct State8080 {
+    REGISTER_PAIR(b, c, bc);
+    REGISTER_PAIR(d, e, de);
+    REGISTER_PAIR(h, l, hl);
+    union {
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        struct { uint8_t a; ConditionCodes cc; };
+#else
+        struct { ConditionCodes cc; uint8_t a; };
+#endif
+        uint16_t psw;       // A in the high byte, flags in the low byte
+    };
+    uint16_t sp;
+    uint16_t pc;
+    uint8_t* memory;
+    uint8_t int_enable;
+    uint8_t halted;         // in HLT; with interrupts off Emulate8080p returns STATUS_HALTED
+    uint64_t cycles;        // emulated clock cycles since Init8080 or Reset8080
+    uint64_t instructions;  // retired by Run8080 since Init8080 or Reset8080
+    uint64_t interrupts;    // taken since Init8080 or Reset8080
+    Profile8080* profile;   // only used by -DPROFILE_OPS=1 builds
+    CallProfile8080* calls; // only used by -DPROFILE_CALLS=1 builds
+    MemoryHeatmap8080* heatmap; // only used by -DPROFILE_MEMORY=1 builds
+    const uint8_t* dead_flags;  // per address, flags not worth computing (FindDeadFlags)
+    void* io;               // for the port callbacks, see AttachCabinet
+    uint8_t (*port_in)(State8080* state, uint8_t port);     // IN, reads 0 if not set
+    void (*port_out)(State8080* state, uint8_t port, uint8_t value);   // OUT, dropped if not set
+};
+
+// Decoded form of one instruction, see Decode8080Op
+struct Instruction8080 {
+    uint8_t opcode;
+    uint8_t mnemonic;       // index for Mnemonic8080
+    uint8_t length;
+    uint8_t cycles;
+    uint16_t operand;       // immediate byte or word, 0 if there isn't one
+};
+
+// PSW is the flags byte pushed under A: S Z 0 AC 0 P 1 CY. cc is kept in
+// that layout, so this is just forcing the fixed bits.
+static inline uint16_t PackPSW(const State8080* state)
+{
+    return (state->psw & 0xffd7) | 0x0002;
+}
+
+// HLT with interrupts off: nothing can wake the cpu again. halted alone is
+// just waiting for the next interrupt.
+static inline int Stopped8080(const State8080* state)
+{
+    return state->halted && !state->int_enable;
+}
+
+#define DISASSEMBLY_MAX 24  // longest Format8080Op text, plus the terminator
+
 int Disassemble8080Op(unsigned char *codebuffer, int pc);
+int Decode8080Op(const unsigned char* code, Instruction8080* op);
+int Format8080Op(const unsigned char* code, char* buffer);
+const char* Mnemonic8080(uint8_t mnemonic);
+int Emulate8080p(State8080* state);
+void GenerateInterrupt(State8080* state, int interrupt_num);
 
 #endif
\ No newline at end of file
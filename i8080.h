@@ -0,0 +1,38 @@
+#ifndef I8080_H
+#define I8080_H
+
+#include <cstdint>
+#include "functions.h"
+
+// The core as a library: machine instances with explicit lifetimes, and
+// status codes where there used to be exit(), so a harness running many
+// machines in one process only loses the one that failed. The core is
+// 8080cpu.cpp and disassembler.cpp and nothing else, e.g.
+//
+//     g++ -O2 -flto -DPRINTOPS=0 -c 8080cpu.cpp disassembler.cpp
+//     ar rcs libi8080.a 8080cpu.o disassembler.o
+//
+// or -fPIC -shared for a libi8080.so. Building the harness with -flto as
+// well lets the hot calls (Run8080, Emulate8080p) inline across the
+// boundary.
+
+enum Status8080 {
+    STATUS_OK = 0,
+    STATUS_HALTED,          // HLT with interrupts off, Emulate8080p returns this
+    STATUS_NO_MEMORY,
+    STATUS_OPEN_FAILED,
+    STATUS_TOO_BIG,         // the file runs past the end of the address space
+    STATUS_READ_FAILED,
+    STATUS_BAD_ROM,         // not the ROM set that was asked for (romset.h)
+    STATUS_WRITE_FAILED,
+    STATUS_BAD_FORMAT,      // not a save state this build reads (statefile.h)
+};
+
+State8080* Init8080();
+void Destroy8080(State8080* state);
+void Reset8080(State8080* state);
+int Run8080(State8080* state, uint64_t cycles);
+int ReadFileIntoMemoryAt(State8080* state, const char* filename, uint32_t offset);
+const char* StatusString8080(int status);
+
+#endif
@@ -0,0 +1,119 @@
+#include <cstdint>
+#include <cstdio>
+#include <stdlib.h>
+#include <atomic>
+#include "machine.h"
+#include "input.h"
+
+// log, if not NULL, gets every event as it is applied.
+InputQueue8080* CreateInputQueue(FILE* log)
+{
+    InputQueue8080* queue = new InputQueue8080();
+    queue->log = log;
+    return queue;
+}
+
+/*
+Queues the new value of port's latch, from the producer thread.
+
+returns 1 if it was queued, 0 if the ring was full and it was dropped
+*/
+int PushInput(InputQueue8080* queue, uint8_t port, uint8_t value)
+{
+    uint32_t head = queue->head.load(std::memory_order_relaxed);
+    if (head - queue->tail.load(std::memory_order_acquire) == INPUT_SLOTS)
+    {
+        queue->dropped++;
+        return 0;
+    }
+    InputEvent8080* event = &queue->events[head & (INPUT_SLOTS - 1)];
+    event->host_ns = MonotonicNs();
+    event->port = port;
+    event->value = value;
+    queue->head.store(head + 1, std::memory_order_release);
+    return 1;
+}
+
+static void Apply(Cabinet8080* cabinet, uint8_t port, uint8_t value)
+{
+    if (port == 1)
+        cabinet->port1 = value;
+    else if (port == 2)
+        cabinet->port2 = value;
+}
+
+/*
+Applies everything queued so far to cabinet, as of the start of frame.
+Several changes to one port within a frame all land, the last one wins.
+
+returns when the newest applied event was pushed, 0 if there were none
+*/
+uint64_t DrainInputs(InputQueue8080* queue, Cabinet8080* cabinet, uint64_t frame)
+{
+    uint32_t tail = queue->tail.load(std::memory_order_relaxed);
+    uint32_t head = queue->head.load(std::memory_order_acquire);
+    uint64_t newest = 0;
+    for (; tail != head; tail++)
+    {
+        const InputEvent8080* event = &queue->events[tail & (INPUT_SLOTS - 1)];
+        Apply(cabinet, event->port, event->value);
+        if (queue->log != NULL)
+            fprintf(queue->log, "%llu %u %u\n", (unsigned long long) frame, event->port, event->value);
+        newest = event->host_ns;
+    }
+    queue->tail.store(tail, std::memory_order_release);
+    return newest;
+}
+
+void DestroyInputQueue(InputQueue8080* queue)
+{
+    delete queue;
+}
+
+static void ReadAhead(InputReplay8080* replay)
+{
+    unsigned long long frame;
+    replay->have = fscanf(replay->in, "%llu %u %u", &frame, &replay->port, &replay->value) == 3;
+    replay->frame = frame;
+}
+
+/*
+Opens an input log written through a queue for replay.
+
+returns NULL if it couldn't be opened
+*/
+InputReplay8080* OpenInputReplay(const char* filename)
+{
+    FILE* in = fopen(filename, "r");
+    if (in == NULL)
+        return NULL;
+    InputReplay8080* replay = (InputReplay8080*) calloc(1, sizeof(InputReplay8080));
+    replay->in = in;
+    ReadAhead(replay);
+    return replay;
+}
+
+/*
+Applies the logged events for frame, in place of DrainInputs.
+
+returns how many were applied
+*/
+int ReplayInputs(InputReplay8080* replay, Cabinet8080* cabinet, uint64_t frame)
+{
+    int applied = 0;
+    while (replay->have && replay->frame <= frame)
+    {
+        Apply(cabinet, replay->port, replay->value);
+        applied++;
+        ReadAhead(replay);
+    }
+    return applied;
+}
+
+void CloseInputReplay(InputReplay8080* replay)
+{
+    if (replay == NULL)
+        return;
+    fclose(replay->in);
+    free(replay);
+}
@@ -0,0 +1,54 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <cstdint>
+#include <cstdio>
+#include <atomic>
+#include "machine.h"
+
+// Controller events from another thread (a keyboard reader, a bot, a
+// socket) reach the emulation thread through a single-producer,
+// single-consumer ring, so IN never waits on a lock: the emulation thread
+// drains the ring once per frame, before running it, into the cabinet's
+// port latches. What gets applied at which frame can be logged, and a
+// replay of the log applies the same values at the same frames, so it
+// runs exactly as the live session did whatever the host timing was.
+//
+// The log is text, one event per line: frame port value.
+
+#define INPUT_SLOTS     256         // power of two
+
+struct InputEvent8080 {
+    uint64_t host_ns;               // MonotonicNs() when it was pushed
+    uint8_t port;                   // 1 or 2
+    uint8_t value;                  // the whole latch, INPUT_* bits
+};
+
+// head is only written by the producer and tail by the consumer, each on
+// its own cache line so they don't bounce between cores
+struct InputQueue8080 {
+    InputEvent8080 events[INPUT_SLOTS];
+    alignas(64) std::atomic<uint32_t> head;
+    alignas(64) std::atomic<uint32_t> tail;
+    uint64_t dropped;               // producer's, pushes onto a full ring
+    FILE* log;                      // consumer's, NULL for none
+};
+
+struct InputReplay8080 {
+    FILE* in;
+    uint64_t frame;                 // of the next event, read ahead
+    unsigned port;
+    unsigned value;
+    int have;
+};
+
+InputQueue8080* CreateInputQueue(FILE* log);
+int PushInput(InputQueue8080* queue, uint8_t port, uint8_t value);
+uint64_t DrainInputs(InputQueue8080* queue, Cabinet8080* cabinet, uint64_t frame);
+void DestroyInputQueue(InputQueue8080* queue);
+
+InputReplay8080* OpenInputReplay(const char* filename);
+int ReplayInputs(InputReplay8080* replay, Cabinet8080* cabinet, uint64_t frame);
+void CloseInputReplay(InputReplay8080* replay);
+
+#endif
@@ -0,0 +1,227 @@
+#include <cstdint>
+#include <cstring>
+#include <time.h>
+#include "machine.h"
+#include "i8080.h"
+#include "profile.h"
+#include "sound.h"
+
+#ifndef PROFILE_MEMORY
+#define PROFILE_MEMORY 0
+#endif
+
+static uint8_t CabinetIn(State8080* state, uint8_t port)
+{
+    Cabinet8080* cabinet = (Cabinet8080*) state->io;
+    switch (port)
+    {
+        case 1: return cabinet->port1 | 0x08;   // bit 3 is always set
+        case 2: return cabinet->port2;
+        case 3: return (cabinet->shift >> (8 - cabinet->shift_offset)) & 0xff;
+    }
+    return 0;
+}
+
+static void CabinetOut(State8080* state, uint8_t port, uint8_t value)
+{
+    Cabinet8080* cabinet = (Cabinet8080*) state->io;
+    if (port == 2)
+    {
+        cabinet->shift_offset = value & 7;
+        return;
+    }
+    if (port == 4)
+    {
+        cabinet->shift = (value << 8) | (cabinet->shift >> 8);
+        return;
+    }
+
+    uint8_t* latch = port == 3 ? &cabinet->port3 : port == 5 ? &cabinet->port5 : NULL;
+    if (latch == NULL || *latch == value)
+        return;
+    *latch = value;
+    if (cabinet->sound != NULL)
+        RecordSound(cabinet->sound, state->cycles, port, value);
+}
+
+void AttachCabinet(State8080* state, Cabinet8080* cabinet)
+{
+    state->io = cabinet;
+    state->port_in = CabinetIn;
+    state->port_out = CabinetOut;
+}
+
+/*
+Runs one 60Hz frame worth of cycles, delivering the mid-screen and vblank
+interrupts along the way.
+
+returns non-zero if the cpu stopped before the frame finished
+*/
+int RunFrame(State8080* state)
+{
+    uint64_t half = state->cycles + CYCLES_PER_FRAME / 2;
+    uint64_t end = state->cycles + CYCLES_PER_FRAME;
+
+    if (Run8080(state, half - state->cycles)) return 1;
+    if (state->int_enable)
+        GenerateInterrupt(state, 1);
+
+    if (Run8080(state, end - state->cycles)) return 1;
+    if (state->int_enable)
+        GenerateInterrupt(state, 2);
+
+#if PROFILE_MEMORY
+    if (state->heatmap != NULL)
+        HeatmapEndFrame(state->heatmap);
+#endif
+    return 0;
+}
+
+// state must have a cabinet attached.
+void SaveState(const State8080* state, SaveState8080* save)
+{
+    save->cpu = *state;
+    save->cabinet = *(const Cabinet8080*) state->io;
+    memcpy(save->ram, &state->memory[RAM_START], sizeof(save->ram));
+}
+
+// Puts back what SaveState kept, leaving the memory, the hooks, the
+// inputs currently held and the work counters alone.
+void LoadState(State8080* state, const SaveState8080* save)
+{
+    State8080 live = *state;
+    *state = save->cpu;
+    state->memory = live.memory;
+    state->profile = live.profile;
+    state->calls = live.calls;
+    state->heatmap = live.heatmap;
+    state->dead_flags = live.dead_flags;
+    state->io = live.io;
+    state->port_in = live.port_in;
+    state->port_out = live.port_out;
+    state->instructions = live.instructions;
+    state->interrupts = live.interrupts;
+
+    Cabinet8080* cabinet = (Cabinet8080*) state->io;
+    Cabinet8080 inputs = *cabinet;
+    *cabinet = save->cabinet;
+    cabinet->port1 = inputs.port1;
+    cabinet->port2 = inputs.port2;
+    cabinet->sound = inputs.sound;
+    memcpy(&state->memory[RAM_START], save->ram, sizeof(save->ram));
+}
+
+uint64_t MonotonicNs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void InitRunAhead(RunAhead8080* ahead, int frames)
+{
+    memset(ahead, 0, sizeof(*ahead));
+    ahead->frames = frames;
+    ahead->worst_headroom_ns = INT64_MAX;
+}
+
+/*
+Runs the real frame with the inputs now held, then, if frames is set,
+saves and runs frames more with the same inputs, their sound unlogged.
+Show the picture in state's VRAM, then call EndRunAhead.
+
+returns non-zero if the cpu stopped during the real frame, and then there
+is nothing to end
+*/
+int BeginRunAhead(RunAhead8080* ahead, State8080* state)
+{
+    ahead->start_ns = MonotonicNs();
+    if (RunFrame(state))
+        return 1;
+    if (ahead->frames == 0)
+        return 0;
+
+    SaveState(state, &ahead->save);
+    Cabinet8080* cabinet = (Cabinet8080*) state->io;
+    SoundEvents8080* sound = cabinet->sound;
+    cabinet->sound = NULL;
+    for (int i = 0; i < ahead->frames && RunFrame(state) == 0; i++)
+        ;
+    cabinet->sound = sound;
+    return 0;
+}
+
+// Goes back to the real frame and works out the headroom.
+void EndRunAhead(RunAhead8080* ahead, State8080* state)
+{
+    if (ahead->frames > 0)
+        LoadState(state, &ahead->save);
+
+    uint64_t spent = MonotonicNs() - ahead->start_ns;
+    ahead->headroom_ns = (int64_t) (1000000000 / FRAMES_PER_SECOND) - (int64_t) spent;
+    if (ahead->headroom_ns < ahead->worst_headroom_ns)
+        ahead->worst_headroom_ns = ahead->headroom_ns;
+    if (ahead->headroom_ns < 0)
+        ahead->late_frames++;
+    ahead->total_ns += spent;
+    ahead->host_frames++;
+}
+
+void InitFrameSkip(FrameSkip8080* frameskip, int skip)
+{
+    frameskip->skip = skip > 0 ? skip : 1;
+    frameskip->countdown = frameskip->skip;
+    frameskip->requested = 0;
+}
+
+/*
+Call once per frame.
+
+returns 1 if this frame should be shown
+*/
+int WantFrame(FrameSkip8080* frameskip)
+{
+    int want = frameskip->requested;
+    if (--frameskip->countdown == 0)
+    {
+        frameskip->countdown = frameskip->skip;
+        want = 1;
+    }
+    frameskip->requested = 0;
+    return want;
+}
+
+// Shows the next frame whatever the skip, e.g. for a screenshot.
+void RequestFrame(FrameSkip8080* frameskip)
+{
+    frameskip->requested = 1;
+}
+
+/*
+Expands VRAM into an 8 bit grayscale picture (0x00 or 0xff per pixel),
+SCREEN_WIDTH x SCREEN_HEIGHT, rotated the way the cabinet shows it.
+*/
+void RenderFrame(const uint8_t* memory, uint8_t* framebuffer)
+{
+    RenderVram(&memory[VRAM_START], framebuffer);
+}
+
+// The same from a copy of VRAM, VRAM_SIZE bytes.
+void RenderVram(const uint8_t* vram, uint8_t* framebuffer)
+{
+    // each VRAM scanline becomes one column of the rotated picture, with
+    // bit 0 of the first byte at the bottom
+    for (int col = 0; col < SCREEN_WIDTH; col++)
+    {
+        const uint8_t* line = &vram[col * 32];
+        for (int i = 0; i < 32; i++)
+        {
+            uint8_t bits = line[i];
+            for (int b = 0; b < 8; b++)
+            {
+                int row = SCREEN_HEIGHT - 1 - (i * 8 + b);
+                framebuffer[row * SCREEN_WIDTH + col] = (bits & (1 << b)) ? 0xff : 0x00;
+            }
+        }
+    }
+}
@@ -0,0 +1,104 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <cstdint>
+#include "functions.h"
+
+// Space Invaders runs the 8080 at 2MHz and redraws at 60Hz. The video
+// hardware fires RST 1 when the beam is in the middle of the screen and
+// RST 2 at the start of vblank.
+#define CPU_HZ              2000000
+#define FRAMES_PER_SECOND   60
+#define CYCLES_PER_FRAME    (CPU_HZ / FRAMES_PER_SECOND)
+
+// Memory map: 8K of ROM, 1K of work RAM, then 7K of video RAM. Everything
+// above 0x4000 is a mirror of the RAM on real hardware.
+#define ROM_SIZE            0x2000
+#define RAM_START           0x2000
+#define RAM_END             0x4000
+
+// The 1bpp framebuffer lives at 0x2400-0x3fff, 32 bytes per scanline. The
+// monitor is rotated 90 degrees counter-clockwise in the cabinet, so the
+// picture we hand out is 224 wide and 256 tall.
+#define VRAM_START          0x2400
+#define VRAM_SIZE           0x1c00
+#define SCREEN_WIDTH        224
+#define SCREEN_HEIGHT       256
+
+struct SoundEvents8080;
+
+// Controls on IN 1 (coin, starts, player 1) and IN 2 (player 2, and the
+// DIP switches, left at 0 for three ships). Set means pressed.
+#define INPUT_COIN          0x01
+#define INPUT_P2_START      0x02
+#define INPUT_P1_START      0x04
+#define INPUT_FIRE          0x10
+#define INPUT_LEFT          0x20
+#define INPUT_RIGHT         0x40
+
+// Work RAM the game keeps its state in
+#define GAME_MODE           0x20ef  // 1 while a game is being played
+#define P1_SCORE            0x20f8  // 4 BCD digits, low byte first
+
+// The hardware on the other side of IN and OUT. AttachCabinet points the
+// core's port callbacks at one.
+struct Cabinet8080 {
+    uint8_t port1;              // inputs, INPUT_* bits
+    uint8_t port2;
+    uint16_t shift;             // the shift register sprites are drawn with:
+    uint8_t shift_offset;       // OUT 4 shifts a byte in, OUT 2 sets where IN 3 reads
+    uint8_t port3;              // sound latches, as last written
+    uint8_t port5;
+    SoundEvents8080* sound;     // changes to them are logged here, if set
+};
+
+// Which frames get a picture when nothing needs every one. The machine
+// still runs every frame with both interrupts; this only decides when the
+// host renders, publishes or streams. With skip n that is the last frame
+// of each n, plus the next frame after a RequestFrame.
+struct FrameSkip8080 {
+    int skip;                   // 1 shows every frame
+    int countdown;              // frames left before the next shown one
+    int requested;
+};
+
+// Everything a frame can change: the cpu, the cabinet's shift register
+// and sound latches, and the RAM. The ROM is never written, so it isn't
+// kept.
+struct SaveState8080 {
+    State8080 cpu;
+    Cabinet8080 cabinet;
+    uint8_t ram[RAM_END - RAM_START];
+};
+
+// Run-ahead hides the ROM's own input lag: each host frame runs the real
+// frame, then frames more from a save state with the same inputs so the
+// picture shown is that far ahead, then goes back. Host frames cost
+// frames + 1 emulated ones, so it keeps track of how much of the 60Hz
+// budget they leave.
+struct RunAhead8080 {
+    int frames;
+    SaveState8080 save;
+    uint64_t start_ns;
+    int64_t headroom_ns;        // of the last host frame, negative if over
+    int64_t worst_headroom_ns;
+    uint64_t total_ns;
+    uint64_t host_frames;
+    uint64_t late_frames;       // over budget
+};
+
+void AttachCabinet(State8080* state, Cabinet8080* cabinet);
+int RunFrame(State8080* state);
+void SaveState(const State8080* state, SaveState8080* save);
+void LoadState(State8080* state, const SaveState8080* save);
+uint64_t MonotonicNs();
+void InitRunAhead(RunAhead8080* ahead, int frames);
+int BeginRunAhead(RunAhead8080* ahead, State8080* state);
+void EndRunAhead(RunAhead8080* ahead, State8080* state);
+void InitFrameSkip(FrameSkip8080* frameskip, int skip);
+int WantFrame(FrameSkip8080* frameskip);
+void RequestFrame(FrameSkip8080* frameskip);
+void RenderFrame(const uint8_t* memory, uint8_t* framebuffer);
+void RenderVram(const uint8_t* vram, uint8_t* framebuffer);
+
+#endif
@@ -0,0 +1,481 @@
+#include <cstdint>
+#include <cstdio>
+#include <stdlib.h>
+#include <cstring>
+#include <signal.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include "functions.h"
+#include "i8080.h"
+#include "machine.h"
+#include "profile.h"
+#include "analysis.h"
+#include "sharedframe.h"
+#include "framestream.h"
+#include "sound.h"
+#include "input.h"
+#include "realtime.h"
+#include "stats.h"
+#include "romset.h"
+#include "statefile.h"
+
+static volatile sig_atomic_t stopped = 0;
+
+static volatile sig_atomic_t snapshot = 0;
+
+static void Stop(int /*signum*/)
+{
+    stopped = 1;
+}
+
+static void Snapshot(int /*signum*/)
+{
+    snapshot = 1;
+}
+
+struct AudioOut {
+    SoundMixer8080* mixer;
+    SoundEvents8080 sound;
+    FILE* file;
+    uint32_t samples;
+    int16_t pcm[SOUND_RATE / FRAMES_PER_SECOND + 1];
+};
+
+// Mixes the frame that just ran; in real time this is on the cpu thread.
+static void MixFrame(State8080* state, void* user)
+{
+    AudioOut* audio = (AudioOut*) user;
+    int n = MixSound(audio->mixer, &audio->sound, state->cycles, audio->pcm,
+                     sizeof(audio->pcm) / sizeof(audio->pcm[0]));
+    fwrite(audio->pcm, sizeof(audio->pcm[0]), n, audio->file);
+    audio->samples += n;
+    audio->sound.count = 0;
+}
+
+static std::atomic<int> bot_running;
+
+// Sleeps ms, a bit at a time so the bot stops promptly.
+static void Nap(int ms)
+{
+    for (; ms > 0 && bot_running.load(); ms -= 50)
+        usleep((ms < 50 ? ms : 50) * 1000);
+}
+
+// Stands in for a player on another thread: drops a coin once the ROM has
+// booted, presses start, then moves and fires at random.
+static void Bot(InputQueue8080* queue)
+{
+    static const uint8_t moves[] = {0, INPUT_FIRE, INPUT_LEFT, INPUT_RIGHT, INPUT_LEFT | INPUT_FIRE, INPUT_RIGHT | INPUT_FIRE};
+    Nap(1500);
+    PushInput(queue, 1, INPUT_COIN);
+    Nap(200);
+    PushInput(queue, 1, 0);
+    Nap(300);
+    PushInput(queue, 1, INPUT_P1_START);
+    Nap(200);
+    uint32_t seed = 1;
+    while (bot_running.load())
+    {
+        seed = seed * 1103515245 + 12345;
+        PushInput(queue, 1, moves[(seed >> 16) % (sizeof(moves) / sizeof(moves[0]))]);
+        Nap(100 + (seed >> 8) % 200);
+    }
+}
+
+/*
+usage: invaders [-R rom] [-l file] [-w file] [-z] [-n frames] [-t] [-b] [-i file] [-p file] [-j file] [-k skip] [-r frames] [-s name] [-v file] [-f y4m|raw] [-a file] [-d dir]
+
+-R loads the ROM from rom, a directory with the split set (invaders.h -
+invaders.e) or a merged file, "invaders" by default, or the compiled-in
+copy in -DEMBED_ROM=1 builds (see romset.h). One that doesn't match the
+known checksums runs with a warning.
+-l starts from the save state in file instead of a reset, -w saves one
+to file at the end of the run, run-length encoded with -z (see
+statefile.h; statetool shows and compares them). A state is refused
+under a ROM other than the one it was saved with.
+-n stops after that many frames instead of running until interrupted.
+-t runs at the real 60Hz instead of flat out, the cpu on its own thread
+handing frames to this one (see realtime.h), and reports the pacing
+jitter and input latency at the end and in -j's lines.
+-b plays with a bot on its own thread, its inputs reaching the machine
+through the lock-free queue in input.h at frame boundaries.
+-i logs every input as applied, by frame, to file; -p replays such a log
+instead of taking live input, which reproduces the logged run exactly.
+A replay runs flat out, -t is ignored with it.
+-j writes the runtime counters as a JSON line every second to file, or
+stderr for "-" (see stats.h), named after -s's segment if there is one.
+-k only publishes and streams every skip-th frame (the machine still runs
+them all); SIGUSR1 gets the next frame out whatever the skip.
+-r shows frames ahead of the real one to hide the ROM's input lag (see
+RunAhead8080), and reports the per-frame headroom at the end.
+-s publishes every frame to the shared-memory segment name (see
+sharedframe.h), one name per running instance.
+-v streams every frame to file, or stdout for "-" (build with
+-DPRINTOPS=0 then), as Y4M or raw gray8 per -f (see framestream.h). Run
+flat out it waits for the writer rather than drop frames; with -t the
+writer has to keep up.
+-a mixes the game's sound into a WAV file, using the samples 0.wav -
+9.wav in -d's directory ("samples" by default, see sound.h).
+*/
+int main (int argc, char**argv)
+{
+    int done = 0;
+#if EMBED_ROM
+    const char* rom_name = NULL;            // the compiled-in one
+#else
+    const char* rom_name = "invaders";
+#endif
+    const char* load_name = NULL;
+    const char* save_name = NULL;
+    int compress = 0;
+    long frames = 0;
+    int skip = 1;
+    int run_ahead = 0;
+    int realtime = 0;
+    int bot = 0;
+    const char* log_name = NULL;
+    const char* replay_name = NULL;
+    const char* stats_name = NULL;
+    const char* shared_name = NULL;
+    const char* video_name = NULL;
+    int video_format = STREAM_Y4M;
+    const char* audio_name = NULL;
+    const char* sample_dir = "samples";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-R") == 0 && i + 1 < argc)
+            rom_name = argv[++i];
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            load_name = argv[++i];
+        else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc)
+            save_name = argv[++i];
+        else if (strcmp(argv[i], "-z") == 0)
+            compress = 1;
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            frames = atol(argv[++i]);
+        else if (strcmp(argv[i], "-t") == 0)
+            realtime = 1;
+        else if (strcmp(argv[i], "-b") == 0)
+            bot = 1;
+        else if (strcmp(argv[i], "-i") == 0 && i + 1 < argc)
+            log_name = argv[++i];
+        else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc)
+            replay_name = argv[++i];
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc)
+            stats_name = argv[++i];
+        else if (strcmp(argv[i], "-k") == 0 && i + 1 < argc)
+            skip = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc)
+            run_ahead = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc)
+            shared_name = argv[++i];
+        else if (strcmp(argv[i], "-v") == 0 && i + 1 < argc)
+            video_name = argv[++i];
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            video_format = strcmp(argv[++i], "raw") == 0 ? STREAM_RAW : STREAM_Y4M;
+        else if (strcmp(argv[i], "-a") == 0 && i + 1 < argc)
+            audio_name = argv[++i];
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc)
+            sample_dir = argv[++i];
+    }
+
+    State8080* state = Init8080();
+    if (state == NULL)
+        return 1;
+
+    static RomSet8080 rom;
+    int status = rom_name != NULL ? OpenRomSet(rom_name, 0, &rom) : OpenEmbeddedRom(&rom);
+    if (rom_name == NULL)
+        rom_name = "embedded ROM";
+    if (status != STATUS_OK)
+    {
+        printf("error: %s: %s\n", rom_name, StatusString8080(status));
+        return 1;
+    }
+    if (!rom.verified)
+        fprintf(stderr, "warning: %s doesn't match the known Space Invaders ROMs\n", rom_name);
+    InstallRom(&rom, state);
+    CloseRomSet(&rom);
+    RomHash8080 rom_hash;
+    HashRom(state->memory, &rom_hash);
+
+    // let the core skip flags the ROM overwrites before reading
+    static CodeMap8080 map;
+    static uint8_t dead[0x10000];
+    uint16_t entries[] = {0x0000, 0x0008, 0x0010};
+    AnalyzeCode(state->memory, ROM_SIZE, entries, 3, &map);
+    FindDeadFlags(&map, state->memory, dead);
+    state->dead_flags = dead;
+#if PROFILE_OPS
+    state->profile = CreateProfile();
+#endif
+#if PROFILE_CALLS
+    state->calls = CreateCallProfile();
+#endif
+#if PROFILE_MEMORY
+    state->heatmap = CreateHeatmap("heatmap", 60, 0);
+#endif
+
+    SharedFrame8080* shared = NULL;
+    if (shared_name != NULL && (shared = CreateSharedFrame(shared_name)) == NULL)
+    {
+        printf("error: Couldn't create shared memory %s\n", shared_name);
+        return 1;
+    }
+
+    FrameStream8080* video = NULL;
+    if (video_name != NULL && (video = OpenFrameStream(video_name, video_format, !realtime, skip)) == NULL)
+    {
+        printf("error: Couldn't open %s\n", video_name);
+        return 1;
+    }
+
+    static Cabinet8080 cabinet;
+    AttachCabinet(state, &cabinet);
+
+    if (load_name != NULL)
+    {
+        StateFile8080 file;
+        if ((status = OpenStateFile(load_name, &file)) == STATUS_OK)
+        {
+            status = LoadStateFile(&file, state, &rom_hash);
+            CloseStateFile(&file);
+        }
+        if (status != STATUS_OK)
+        {
+            printf("error: %s: %s\n", load_name, StatusString8080(status));
+            return 1;
+        }
+    }
+
+    static AudioOut audio;
+    if (audio_name != NULL)
+    {
+        int loaded;
+        audio.mixer = CreateSoundMixer(sample_dir, SOUND_RATE, &loaded);
+        if (loaded == 0)
+            fprintf(stderr, "warning: no samples in %s, the sound will be silent\n", sample_dir);
+        if ((audio.file = OpenWav(audio_name, SOUND_RATE)) == NULL)
+        {
+            printf("error: Couldn't open %s\n", audio_name);
+            return 1;
+        }
+        cabinet.sound = &audio.sound;
+    }
+
+    InputReplay8080* replay = NULL;
+    InputQueue8080* inputs = NULL;
+    FILE* input_log = NULL;
+    std::thread bot_thread;
+    if (replay_name != NULL)
+    {
+        if ((replay = OpenInputReplay(replay_name)) == NULL)
+        {
+            printf("error: Couldn't open %s\n", replay_name);
+            return 1;
+        }
+        realtime = 0;
+    }
+    else if (bot || log_name != NULL)
+    {
+        if (log_name != NULL && (input_log = fopen(log_name, "w")) == NULL)
+        {
+            printf("error: Couldn't open %s\n", log_name);
+            return 1;
+        }
+        inputs = CreateInputQueue(input_log);
+    }
+    if (bot && inputs != NULL)
+    {
+        bot_running.store(1);
+        bot_thread = std::thread(Bot, inputs);
+    }
+
+    FILE* stats_out = NULL;
+    static StatsReporter8080 reporter;
+    static Stats8080 counters;
+    if (stats_name != NULL)
+    {
+        stats_out = strcmp(stats_name, "-") == 0 ? stderr : fopen(stats_name, "w");
+        if (stats_out == NULL)
+        {
+            printf("error: Couldn't open %s\n", stats_name);
+            return 1;
+        }
+        InitStatsReporter(&reporter, stats_out, shared_name != NULL ? shared_name : "invaders",
+                          STATS_INTERVAL_NS);
+    }
+
+    // ^C ends the run normally, so profiles get written and the segment
+    // goes away
+    signal(SIGINT, Stop);
+    signal(SIGTERM, Stop);
+    signal(SIGUSR1, Snapshot);
+
+    FrameSkip8080 frameskip;
+    InitFrameSkip(&frameskip, skip);
+    static RunAhead8080 ahead;
+    InitRunAhead(&ahead, run_ahead);
+
+    if (realtime)
+    {
+        Realtime8080* rt = StartRealtime(state, frames, REALTIME_SPIN_NS, run_ahead, inputs,
+                                         audio.file != NULL ? MixFrame : NULL, &audio);
+        while (!stopped)
+        {
+            const PresentSlot* slot = WaitFrame(rt, 100);
+            if (slot == NULL)
+            {
+                if (rt->finished.load())
+                    break;
+                continue;
+            }
+            if (snapshot)
+            {
+                snapshot = 0;
+                RequestFrame(&frameskip);
+            }
+            uint64_t lap = MonotonicNs();
+            if (WantFrame(&frameskip))
+            {
+                if (shared != NULL)
+                    PublishMemory(shared, slot->memory, slot->cycles);
+                Lap(&counters.render_ns, &lap);
+                if (video != NULL)
+                    PushFrame(video, slot->memory);
+                Lap(&counters.io_ns, &lap);
+            }
+            if (stats_out != NULL)
+            {
+                // the cpu thread's counters come with the frame, this
+                // thread adds its own time and the latency it saw
+                Stats8080 total = slot->stats;
+                AddStats(&total, &rt->shown);
+                AddStats(&total, &counters);
+                ReportStats(&reporter, &total, 0);
+            }
+        }
+        StopRealtime(rt);
+        done = Stopped8080(state);
+
+        Stats8080 total = rt->counters;
+        AddStats(&total, &rt->shown);
+        AddStats(&total, &counters);
+        fprintf(stderr, "real time: %llu frames, %llu presented, jitter %.0f ns mean %llu ns max, %llu overruns\n",
+                (unsigned long long) total.paced_frames, (unsigned long long) total.presented,
+                total.paced_frames > total.overruns
+                    ? (double) total.jitter_total_ns / (total.paced_frames - total.overruns) : 0.0,
+                (unsigned long long) total.jitter_max_ns, (unsigned long long) total.overruns);
+        if (total.latency_count > 0)
+            fprintf(stderr, "input to frame: %.0f ns mean %llu ns max over %llu changes\n",
+                    (double) total.latency_total_ns / total.latency_count,
+                    (unsigned long long) total.latency_max_ns, (unsigned long long) total.latency_count);
+        ahead = rt->ahead;
+        if (stats_out != NULL)
+            ReportStats(&reporter, &total, 1);
+        DestroyRealtime(rt);
+    }
+
+    for (long frame = 0; !realtime && done == 0 && !stopped && (frames == 0 || frame < frames); frame++)
+    {
+        if (snapshot)
+        {
+            snapshot = 0;
+            RequestFrame(&frameskip);
+        }
+        uint64_t lap = MonotonicNs();
+        if (replay != NULL)
+            ReplayInputs(replay, &cabinet, frame);
+        else if (inputs != NULL)
+            DrainInputs(inputs, &cabinet, frame);
+        Lap(&counters.io_ns, &lap);
+
+        // no point looking ahead for a frame nobody sees
+        int show = WantFrame(&frameskip);
+        ahead.frames = show ? run_ahead : 0;
+        done = BeginRunAhead(&ahead, state);
+        Lap(&counters.cpu_ns, &lap);
+        if (done == 0)
+        {
+            if (show)
+            {
+                if (shared != NULL)
+                    PublishFrame(shared, state);
+                Lap(&counters.render_ns, &lap);
+                if (video != NULL)
+                    PushFrame(video, state->memory);
+                Lap(&counters.io_ns, &lap);
+            }
+            EndRunAhead(&ahead, state);
+            Lap(&counters.cpu_ns, &lap);
+        }
+        if (audio.file != NULL)
+            MixFrame(state, &audio);
+        Lap(&counters.io_ns, &lap);
+
+        counters.frames++;
+        if (stats_out != NULL)
+        {
+            CollectStats(&counters, state);
+            ReportStats(&reporter, &counters, 0);
+        }
+    }
+    if (stats_out != NULL && !realtime)
+        ReportStats(&reporter, &counters, 1);
+    if (save_name != NULL && (status = WriteStateFile(save_name, state, &rom_hash, compress)) != STATUS_OK)
+        fprintf(stderr, "error: %s: %s\n", save_name, StatusString8080(status));
+    if (bot_thread.joinable())
+    {
+        bot_running.store(0);
+        bot_thread.join();
+    }
+    if (inputs != NULL)
+    {
+        if (inputs->dropped > 0)
+            fprintf(stderr, "%llu inputs dropped\n", (unsigned long long) inputs->dropped);
+        DestroyInputQueue(inputs);
+    }
+    if (input_log != NULL)
+        fclose(input_log);
+    CloseInputReplay(replay);
+    if (stats_out != NULL && stats_out != stderr)
+        fclose(stats_out);
+    if (run_ahead > 0 && ahead.host_frames > 0)
+        fprintf(stderr, "run-ahead %d: %.0f ns per frame, worst headroom %.0f ns, %llu frames late\n",
+                run_ahead, (double) ahead.total_ns / ahead.host_frames, (double) ahead.worst_headroom_ns,
+                (unsigned long long) ahead.late_frames);
+    if (audio.file != NULL)
+        CloseWav(audio.file, audio.samples);
+    if (shared != NULL)
+        DestroySharedFrame(shared, shared_name);
+    if (video != NULL)
+    {
+        fprintf(stderr, "%llu frames streamed, %llu repeats, %llu dropped\n",
+                (unsigned long long) video->frames, (unsigned long long) video->repeats,
+                (unsigned long long) video->dropped);
+        CloseFrameStream(video);
+    }
+#if PROFILE_OPS
+    PrintProfile(state->profile, state->memory, 32);
+#endif
+#if PROFILE_CALLS
+    FILE* folded = fopen("calls_cycles.folded", "w");
+    if (folded != NULL)
+    {
+        WriteFoldedStacks(state->calls, folded, 0);
+        fclose(folded);
+    }
+    folded = fopen("calls_ns.folded", "w");
+    if (folded != NULL)
+    {
+        WriteFoldedStacks(state->calls, folded, 1);
+        fclose(folded);
+    }
+#endif
+#if PROFILE_MEMORY
+    WriteHeatmap(state->heatmap);
+#endif
+    return Stopped8080(state);
+}
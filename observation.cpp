@@ -0,0 +1,171 @@
+#include <cstdint>
+#include <cstring>
+#include <stdlib.h>
+#include "observation.h"
+
+#define LINE_BYTES  32      // one VRAM scanline, 256 pixels
+
+// without the instruction the builtin is a call into libgcc, slower than
+// doing it in place
+static inline int Popcount(uint64_t x)
+{
+#if defined(__POPCNT__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (x * 0x0101010101010101ull) >> 56;
+#endif
+}
+
+static inline uint64_t LoadWord(const uint8_t* p)
+{
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    return word;
+}
+
+/*
+Works out which VRAM bits feed each output pixel. Blocks are as even as
+integer division makes them, so 84 rows from 256 are 3 or 4 pixels tall.
+
+returns 0 if the size is out of range
+*/
+int InitObservation(ObservationKernel8080* kernel, int width, int height, int pool)
+{
+    if (width < 1 || width > SCREEN_WIDTH || height < 1 || height > SCREEN_HEIGHT)
+        return 0;
+    memset(kernel, 0, sizeof(*kernel));
+    kernel->width = width;
+    kernel->height = height;
+    kernel->pool = pool;
+
+    for (int x = 0; x <= width; x++)
+        kernel->first_line[x] = x * SCREEN_WIDTH / width;
+    kernel->narrow = SCREEN_WIDTH / width;
+
+    for (int y = 0; y < height; y++)
+    {
+        // picture rows r0..r1-1 are bits 256-r1 .. 255-r0 of a scanline
+        int r0 = y * SCREEN_HEIGHT / height;
+        int r1 = (y + 1) * SCREEN_HEIGHT / height;
+        int lo = SCREEN_HEIGHT - r1;
+        int hi = SCREEN_HEIGHT - 1 - r0;
+        RowBand* band = &kernel->rows[y];
+        for (int w = lo / 64; w <= hi / 64; w++)
+        {
+            int from = lo > w * 64 ? lo - w * 64 : 0;
+            int to = hi < w * 64 + 63 ? hi - w * 64 : 63;
+            uint64_t mask = (to == 63 ? ~0ull : (1ull << (to + 1)) - 1) & ~((1ull << from) - 1);
+            band->word[band->parts] = w;
+            band->mask[band->parts] = mask;
+            band->parts++;
+        }
+        for (int n = 0; n < 2; n++)
+        {
+            uint32_t area = (kernel->narrow + n) * (r1 - r0);
+            kernel->scale[n][y] = (255u * 65536 + area / 2) / area;
+        }
+    }
+    return 1;
+}
+
+/*
+Writes a height x width picture to out, rows top to bottom, from
+VRAM_SIZE bytes of VRAM.
+*/
+void ExtractObservation(const ObservationKernel8080* kernel, const uint8_t* vram, uint8_t* out)
+{
+    uint32_t counts[OBSERVATION_MAX];
+
+    for (int x = 0; x < kernel->width; x++)
+    {
+        int first = kernel->first_line[x];
+        int last = kernel->first_line[x + 1];
+
+        // max pooling only asks whether any bit is set, so OR the lines
+        // together and test each block once
+        if (kernel->pool == POOL_MAX)
+        {
+            uint64_t words[4] = {0, 0, 0, 0};
+            for (int line = first; line < last; line++)
+            {
+                const uint8_t* p = &vram[line * LINE_BYTES];
+                for (int w = 0; w < 4; w++)
+                    words[w] |= LoadWord(p + w * 8);
+            }
+            for (int y = 0; y < kernel->height; y++)
+            {
+                const RowBand* band = &kernel->rows[y];
+                uint64_t lit = words[band->word[0]] & band->mask[0];
+                for (int i = 1; i < band->parts; i++)
+                    lit |= words[band->word[i]] & band->mask[i];
+                out[y * kernel->width + x] = lit ? 0xff : 0x00;
+            }
+            continue;
+        }
+
+        memset(counts, 0, kernel->height * sizeof(counts[0]));
+        for (int line = first; line < last; line++)
+        {
+            const uint8_t* p = &vram[line * LINE_BYTES];
+            uint64_t words[4] = {LoadWord(p), LoadWord(p + 8), LoadWord(p + 16), LoadWord(p + 24)};
+            for (int y = 0; y < kernel->height; y++)
+            {
+                const RowBand* band = &kernel->rows[y];
+                uint32_t count = Popcount(words[band->word[0]] & band->mask[0]);
+                for (int i = 1; i < band->parts; i++)
+                    count += Popcount(words[band->word[i]] & band->mask[i]);
+                counts[y] += count;
+            }
+        }
+
+        const uint32_t* scale = kernel->scale[last - first - kernel->narrow];
+        for (int y = 0; y < kernel->height; y++)
+            out[y * kernel->width + x] = (counts[y] * scale[y] + 0x8000) >> 16;
+    }
+}
+
+FrameStack8080* CreateFrameStack(int depth, int size)
+{
+    FrameStack8080* stack = (FrameStack8080*) calloc(1, sizeof(FrameStack8080));
+    stack->depth = depth;
+    stack->size = size;
+    stack->frames = (uint8_t*) calloc((size_t) depth, size);
+    return stack;
+}
+
+// Where the next observation goes; it replaces the oldest.
+uint8_t* NextStackSlot(FrameStack8080* stack)
+{
+    uint8_t* slot = &stack->frames[(size_t) stack->next * stack->size];
+    stack->next = (stack->next + 1) % stack->depth;
+    return slot;
+}
+
+// A new episode starts with every slot showing its first frame.
+void FillFrameStack(FrameStack8080* stack, const uint8_t* observation)
+{
+    for (int i = 0; i < stack->depth; i++)
+        memcpy(&stack->frames[(size_t) i * stack->size], observation, stack->size);
+    stack->next = 0;
+}
+
+void CopyFrameStack(const FrameStack8080* stack, uint8_t* out)
+{
+    size_t older = (size_t) (stack->depth - stack->next) * stack->size;
+    memcpy(out, &stack->frames[(size_t) stack->next * stack->size], older);
+    memcpy(out + older, stack->frames, (size_t) stack->next * stack->size);
+}
+
+void DestroyFrameStack(FrameStack8080* stack)
+{
+    if (stack == NULL)
+        return;
+    free(stack->frames);
+    free(stack);
+}
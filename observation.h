@@ -0,0 +1,57 @@
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include <cstdint>
+#include "machine.h"
+
+// Downsampled observations straight from the 1bpp VRAM, for agents that
+// want something like 84x84 rather than the whole 224x256 picture. Each
+// output pixel covers a block of VRAM bits; since a VRAM scanline is one
+// column of the rotated picture, a block is a run of bits in each of a few
+// scanlines, so the kernel masks 64 bit words and counts with popcount
+// instead of visiting pixels. Build with -mpopcnt (or -march=native) to
+// count with the instruction rather than with shifts and masks.
+
+#define OBSERVATION_MAX     256     // per side, no upscaling
+
+enum ObservationPool {
+    POOL_AVERAGE,                   // share of lit pixels in the block, 0-255
+    POOL_MAX,                       // 255 if any pixel in the block is lit
+};
+
+// the bits of one output row's block in a scanline, up to one mask per word
+struct RowBand {
+    uint8_t parts;
+    uint8_t word[4];
+    uint64_t mask[4];
+};
+
+struct ObservationKernel8080 {
+    int width;
+    int height;
+    int pool;
+    uint16_t first_line[OBSERVATION_MAX + 1];  // output column x reads lines first_line[x] to first_line[x+1] - 1
+    RowBand rows[OBSERVATION_MAX];
+    int narrow;                                 // fewest lines any output column reads
+    uint32_t scale[2][OBSERVATION_MAX];         // 255 / block area in 16.16, for narrow and narrow + 1 lines
+};
+
+int InitObservation(ObservationKernel8080* kernel, int width, int height, int pool);
+void ExtractObservation(const ObservationKernel8080* kernel, const uint8_t* vram, uint8_t* out);
+
+// The last depth observations of one machine, oldest first once copied
+// out, the usual input for agents that need to see motion.
+struct FrameStack8080 {
+    int depth;
+    int size;                       // bytes per observation
+    int next;                       // slot the next observation goes in
+    uint8_t* frames;                // depth * size, a ring
+};
+
+FrameStack8080* CreateFrameStack(int depth, int size);
+uint8_t* NextStackSlot(FrameStack8080* stack);
+void FillFrameStack(FrameStack8080* stack, const uint8_t* observation);
+void CopyFrameStack(const FrameStack8080* stack, uint8_t* out);
+void DestroyFrameStack(FrameStack8080* stack);
+
+#endif
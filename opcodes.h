@@ -0,0 +1,387 @@
+#ifndef OPCODES_H
+#define OPCODES_H
+
+#include <cstdint>
+
+// One description of every opcode, shared by the cpu (length and cycles),
+// the disassembler (text), the code analysis (control flow) and the flag
+// liveness pass (flags read and written). It's constexpr so templates and
+// compile time checks can use it too.
+
+enum Mnemonic8080 {
+    MN_NOP, MN_LXI, MN_STAX, MN_INX, MN_INR, MN_DCR, MN_MVI, MN_RLC, MN_DAD,
+    MN_LDAX, MN_DCX, MN_RRC, MN_RAL, MN_RAR, MN_SHLD, MN_DAA, MN_LHLD, MN_CMA,
+    MN_STA, MN_STC, MN_LDA, MN_CMC, MN_MOV, MN_HLT, MN_ADD, MN_ADC, MN_SUB,
+    MN_SBB, MN_ANA, MN_XRA, MN_ORA, MN_CMP, MN_RNZ, MN_POP, MN_JNZ, MN_JMP,
+    MN_CNZ, MN_PUSH, MN_ADI, MN_RST, MN_RZ, MN_RET, MN_JZ, MN_CZ, MN_CALL,
+    MN_ACI, MN_RNC, MN_JNC, MN_OUT, MN_CNC, MN_SUI, MN_RC, MN_JC, MN_IN, MN_CC,
+    MN_SBI, MN_RPO, MN_JPO, MN_XTHL, MN_CPO, MN_ANI, MN_RPE, MN_PCHL, MN_JPE,
+    MN_XCHG, MN_CPE, MN_XRI, MN_RP, MN_JP, MN_DI, MN_CP, MN_ORI, MN_RM,
+    MN_SPHL, MN_JM, MN_EI, MN_CM, MN_CPI
+};
+
+constexpr const char* mnemonics8080[] = {
+    "NOP", "LXI", "STAX", "INX", "INR", "DCR", "MVI", "RLC", "DAD", "LDAX",
+    "DCX", "RRC", "RAL", "RAR", "SHLD", "DAA", "LHLD", "CMA", "STA", "STC",
+    "LDA", "CMC", "MOV", "HLT", "ADD", "ADC", "SUB", "SBB", "ANA", "XRA",
+    "ORA", "CMP", "RNZ", "POP", "JNZ", "JMP", "CNZ", "PUSH", "ADI", "RST",
+    "RZ", "RET", "JZ", "CZ", "CALL", "ACI", "RNC", "JNC", "OUT", "CNC", "SUI",
+    "RC", "JC", "IN", "CC", "SBI", "RPO", "JPO", "XTHL", "CPO", "ANI", "RPE",
+    "PCHL", "JPE", "XCHG", "CPE", "XRI", "RP", "JP", "DI", "CP", "ORI", "RM",
+    "SPHL", "JM", "EI", "CM", "CPI"
+};
+
+// flag bits, in their PSW positions
+#define FLAG_CY     0x01
+#define FLAG_P      0x04
+#define FLAG_AC     0x10
+#define FLAG_Z      0x40
+#define FLAG_S      0x80
+#define FLAGS_ALL   (FLAG_S|FLAG_Z|FLAG_AC|FLAG_P|FLAG_CY)
+
+enum Flow8080 {
+    FLOW_NONE,
+    FLOW_JUMP,
+    FLOW_BRANCH,                // Jcc
+    FLOW_CALL,
+    FLOW_CONDITIONAL_CALL,
+    FLOW_RST,
+    FLOW_RETURN,
+    FLOW_CONDITIONAL_RETURN,
+    FLOW_INDIRECT,              // PCHL
+    FLOW_HALT,
+};
+
+struct OpInfo8080 {
+    uint8_t mnemonic;
+    const char* args;           // fixed operand text, an immediate is appended in hex
+    uint8_t length;
+    uint8_t cycles;             // for conditional calls and returns, when taken
+    uint8_t cycles_not_taken;
+    uint8_t flags_read;
+    uint8_t flags_written;
+    uint8_t flow;
+};
+
+constexpr OpInfo8080 opinfo8080[256] = {
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 00
+    {MN_LXI, "B,#$", 3, 10, 10, 0, 0, FLOW_NONE},                          // 01
+    {MN_STAX, "B", 1, 7, 7, 0, 0, FLOW_NONE},                              // 02
+    {MN_INX, "B", 1, 5, 5, 0, 0, FLOW_NONE},                               // 03
+    {MN_INR, "B", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 04
+    {MN_DCR, "B", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 05
+    {MN_MVI, "B,#$", 2, 7, 7, 0, 0, FLOW_NONE},                            // 06
+    {MN_RLC, "", 1, 4, 4, 0, FLAG_CY, FLOW_NONE},                          // 07
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 08
+    {MN_DAD, "B", 1, 10, 10, 0, FLAG_CY, FLOW_NONE},                       // 09
+    {MN_LDAX, "B", 1, 7, 7, 0, 0, FLOW_NONE},                              // 0a
+    {MN_DCX, "B", 1, 5, 5, 0, 0, FLOW_NONE},                               // 0b
+    {MN_INR, "C", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 0c
+    {MN_DCR, "C", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 0d
+    {MN_MVI, "C,#$", 2, 7, 7, 0, 0, FLOW_NONE},                            // 0e
+    {MN_RRC, "", 1, 4, 4, 0, FLAG_CY, FLOW_NONE},                          // 0f
+
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 10
+    {MN_LXI, "D,#$", 3, 10, 10, 0, 0, FLOW_NONE},                          // 11
+    {MN_STAX, "D", 1, 7, 7, 0, 0, FLOW_NONE},                              // 12
+    {MN_INX, "D", 1, 5, 5, 0, 0, FLOW_NONE},                               // 13
+    {MN_INR, "D", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 14
+    {MN_DCR, "D", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 15
+    {MN_MVI, "D,#$", 2, 7, 7, 0, 0, FLOW_NONE},                            // 16
+    {MN_RAL, "", 1, 4, 4, FLAG_CY, FLAG_CY, FLOW_NONE},                    // 17
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 18
+    {MN_DAD, "D", 1, 10, 10, 0, FLAG_CY, FLOW_NONE},                       // 19
+    {MN_LDAX, "D", 1, 7, 7, 0, 0, FLOW_NONE},                              // 1a
+    {MN_DCX, "D", 1, 5, 5, 0, 0, FLOW_NONE},                               // 1b
+    {MN_INR, "E", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 1c
+    {MN_DCR, "E", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 1d
+    {MN_MVI, "E,#$", 2, 7, 7, 0, 0, FLOW_NONE},                            // 1e
+    {MN_RAR, "", 1, 4, 4, FLAG_CY, FLAG_CY, FLOW_NONE},                    // 1f
+
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 20
+    {MN_LXI, "H,#$", 3, 10, 10, 0, 0, FLOW_NONE},                          // 21
+    {MN_SHLD, "$", 3, 16, 16, 0, 0, FLOW_NONE},                            // 22
+    {MN_INX, "H", 1, 5, 5, 0, 0, FLOW_NONE},                               // 23
+    {MN_INR, "H", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 24
+    {MN_DCR, "H", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 25
+    {MN_MVI, "H,#$", 2, 7, 7, 0, 0, FLOW_NONE},                            // 26
+    {MN_DAA, "", 1, 4, 4, FLAG_AC|FLAG_CY, FLAGS_ALL, FLOW_NONE},          // 27
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 28
+    {MN_DAD, "H", 1, 10, 10, 0, FLAG_CY, FLOW_NONE},                       // 29
+    {MN_LHLD, "$", 3, 16, 16, 0, 0, FLOW_NONE},                            // 2a
+    {MN_DCX, "H", 1, 5, 5, 0, 0, FLOW_NONE},                               // 2b
+    {MN_INR, "L", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 2c
+    {MN_DCR, "L", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 2d
+    {MN_MVI, "L,#$", 2, 7, 7, 0, 0, FLOW_NONE},                            // 2e
+    {MN_CMA, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 2f
+
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 30
+    {MN_LXI, "SP,#$", 3, 10, 10, 0, 0, FLOW_NONE},                         // 31
+    {MN_STA, "$", 3, 13, 13, 0, 0, FLOW_NONE},                             // 32
+    {MN_INX, "SP", 1, 5, 5, 0, 0, FLOW_NONE},                              // 33
+    {MN_INR, "M", 1, 10, 10, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},  // 34
+    {MN_DCR, "M", 1, 10, 10, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},  // 35
+    {MN_MVI, "M,#$", 2, 10, 10, 0, 0, FLOW_NONE},                          // 36
+    {MN_STC, "", 1, 4, 4, 0, FLAG_CY, FLOW_NONE},                          // 37
+    {MN_NOP, "", 1, 4, 4, 0, 0, FLOW_NONE},                                // 38
+    {MN_DAD, "SP", 1, 10, 10, 0, FLAG_CY, FLOW_NONE},                      // 39
+    {MN_LDA, "$", 3, 13, 13, 0, 0, FLOW_NONE},                             // 3a
+    {MN_DCX, "SP", 1, 5, 5, 0, 0, FLOW_NONE},                              // 3b
+    {MN_INR, "A", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 3c
+    {MN_DCR, "A", 1, 5, 5, 0, FLAG_S|FLAG_Z|FLAG_AC|FLAG_P, FLOW_NONE},    // 3d
+    {MN_MVI, "A,#$", 2, 7, 7, 0, 0, FLOW_NONE},                            // 3e
+    {MN_CMC, "", 1, 4, 4, FLAG_CY, FLAG_CY, FLOW_NONE},                    // 3f
+
+    {MN_MOV, "B,B", 1, 5, 5, 0, 0, FLOW_NONE},                             // 40
+    {MN_MOV, "B,C", 1, 5, 5, 0, 0, FLOW_NONE},                             // 41
+    {MN_MOV, "B,D", 1, 5, 5, 0, 0, FLOW_NONE},                             // 42
+    {MN_MOV, "B,E", 1, 5, 5, 0, 0, FLOW_NONE},                             // 43
+    {MN_MOV, "B,H", 1, 5, 5, 0, 0, FLOW_NONE},                             // 44
+    {MN_MOV, "B,L", 1, 5, 5, 0, 0, FLOW_NONE},                             // 45
+    {MN_MOV, "B,M", 1, 7, 7, 0, 0, FLOW_NONE},                             // 46
+    {MN_MOV, "B,A", 1, 5, 5, 0, 0, FLOW_NONE},                             // 47
+    {MN_MOV, "C,B", 1, 5, 5, 0, 0, FLOW_NONE},                             // 48
+    {MN_MOV, "C,C", 1, 5, 5, 0, 0, FLOW_NONE},                             // 49
+    {MN_MOV, "C,D", 1, 5, 5, 0, 0, FLOW_NONE},                             // 4a
+    {MN_MOV, "C,E", 1, 5, 5, 0, 0, FLOW_NONE},                             // 4b
+    {MN_MOV, "C,H", 1, 5, 5, 0, 0, FLOW_NONE},                             // 4c
+    {MN_MOV, "C,L", 1, 5, 5, 0, 0, FLOW_NONE},                             // 4d
+    {MN_MOV, "C,M", 1, 7, 7, 0, 0, FLOW_NONE},                             // 4e
+    {MN_MOV, "C,A", 1, 5, 5, 0, 0, FLOW_NONE},                             // 4f
+
+    {MN_MOV, "D,B", 1, 5, 5, 0, 0, FLOW_NONE},                             // 50
+    {MN_MOV, "D,C", 1, 5, 5, 0, 0, FLOW_NONE},                             // 51
+    {MN_MOV, "D,D", 1, 5, 5, 0, 0, FLOW_NONE},                             // 52
+    {MN_MOV, "D,E", 1, 5, 5, 0, 0, FLOW_NONE},                             // 53
+    {MN_MOV, "D,H", 1, 5, 5, 0, 0, FLOW_NONE},                             // 54
+    {MN_MOV, "D,L", 1, 5, 5, 0, 0, FLOW_NONE},                             // 55
+    {MN_MOV, "D,M", 1, 7, 7, 0, 0, FLOW_NONE},                             // 56
+    {MN_MOV, "D,A", 1, 5, 5, 0, 0, FLOW_NONE},                             // 57
+    {MN_MOV, "E,B", 1, 5, 5, 0, 0, FLOW_NONE},                             // 58
+    {MN_MOV, "E,C", 1, 5, 5, 0, 0, FLOW_NONE},                             // 59
+    {MN_MOV, "E,D", 1, 5, 5, 0, 0, FLOW_NONE},                             // 5a
+    {MN_MOV, "E,E", 1, 5, 5, 0, 0, FLOW_NONE},                             // 5b
+    {MN_MOV, "E,H", 1, 5, 5, 0, 0, FLOW_NONE},                             // 5c
+    {MN_MOV, "E,L", 1, 5, 5, 0, 0, FLOW_NONE},                             // 5d
+    {MN_MOV, "E,M", 1, 7, 7, 0, 0, FLOW_NONE},                             // 5e
+    {MN_MOV, "E,A", 1, 5, 5, 0, 0, FLOW_NONE},                             // 5f
+
+    {MN_MOV, "H,B", 1, 5, 5, 0, 0, FLOW_NONE},                             // 60
+    {MN_MOV, "H,C", 1, 5, 5, 0, 0, FLOW_NONE},                             // 61
+    {MN_MOV, "H,D", 1, 5, 5, 0, 0, FLOW_NONE},                             // 62
+    {MN_MOV, "H,E", 1, 5, 5, 0, 0, FLOW_NONE},                             // 63
+    {MN_MOV, "H,H", 1, 5, 5, 0, 0, FLOW_NONE},                             // 64
+    {MN_MOV, "H,L", 1, 5, 5, 0, 0, FLOW_NONE},                             // 65
+    {MN_MOV, "H,M", 1, 7, 7, 0, 0, FLOW_NONE},                             // 66
+    {MN_MOV, "H,A", 1, 5, 5, 0, 0, FLOW_NONE},                             // 67
+    {MN_MOV, "L,B", 1, 5, 5, 0, 0, FLOW_NONE},                             // 68
+    {MN_MOV, "L,C", 1, 5, 5, 0, 0, FLOW_NONE},                             // 69
+    {MN_MOV, "L,D", 1, 5, 5, 0, 0, FLOW_NONE},                             // 6a
+    {MN_MOV, "L,E", 1, 5, 5, 0, 0, FLOW_NONE},                             // 6b
+    {MN_MOV, "L,H", 1, 5, 5, 0, 0, FLOW_NONE},                             // 6c
+    {MN_MOV, "L,L", 1, 5, 5, 0, 0, FLOW_NONE},                             // 6d
+    {MN_MOV, "L,M", 1, 7, 7, 0, 0, FLOW_NONE},                             // 6e
+    {MN_MOV, "L,A", 1, 5, 5, 0, 0, FLOW_NONE},                             // 6f
+
+    {MN_MOV, "M,B", 1, 7, 7, 0, 0, FLOW_NONE},                             // 70
+    {MN_MOV, "M,C", 1, 7, 7, 0, 0, FLOW_NONE},                             // 71
+    {MN_MOV, "M,D", 1, 7, 7, 0, 0, FLOW_NONE},                             // 72
+    {MN_MOV, "M,E", 1, 7, 7, 0, 0, FLOW_NONE},                             // 73
+    {MN_MOV, "M,H", 1, 7, 7, 0, 0, FLOW_NONE},                             // 74
+    {MN_MOV, "M,L", 1, 7, 7, 0, 0, FLOW_NONE},                             // 75
+    {MN_HLT, "", 1, 7, 7, 0, 0, FLOW_HALT},                                // 76
+    {MN_MOV, "M,A", 1, 7, 7, 0, 0, FLOW_NONE},                             // 77
+    {MN_MOV, "A,B", 1, 5, 5, 0, 0, FLOW_NONE},                             // 78
+    {MN_MOV, "A,C", 1, 5, 5, 0, 0, FLOW_NONE},                             // 79
+    {MN_MOV, "A,D", 1, 5, 5, 0, 0, FLOW_NONE},                             // 7a
+    {MN_MOV, "A,E", 1, 5, 5, 0, 0, FLOW_NONE},                             // 7b
+    {MN_MOV, "A,H", 1, 5, 5, 0, 0, FLOW_NONE},                             // 7c
+    {MN_MOV, "A,L", 1, 5, 5, 0, 0, FLOW_NONE},                             // 7d
+    {MN_MOV, "A,M", 1, 7, 7, 0, 0, FLOW_NONE},                             // 7e
+    {MN_MOV, "A,A", 1, 5, 5, 0, 0, FLOW_NONE},                             // 7f
+
+    {MN_ADD, "B", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 80
+    {MN_ADD, "C", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 81
+    {MN_ADD, "D", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 82
+    {MN_ADD, "E", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 83
+    {MN_ADD, "H", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 84
+    {MN_ADD, "L", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 85
+    {MN_ADD, "M", 1, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                       // 86
+    {MN_ADD, "A", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 87
+    {MN_ADC, "B", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 88
+    {MN_ADC, "C", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 89
+    {MN_ADC, "D", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 8a
+    {MN_ADC, "E", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 8b
+    {MN_ADC, "H", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 8c
+    {MN_ADC, "L", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 8d
+    {MN_ADC, "M", 1, 7, 7, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 8e
+    {MN_ADC, "A", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 8f
+
+    {MN_SUB, "B", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 90
+    {MN_SUB, "C", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 91
+    {MN_SUB, "D", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 92
+    {MN_SUB, "E", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 93
+    {MN_SUB, "H", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 94
+    {MN_SUB, "L", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 95
+    {MN_SUB, "M", 1, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                       // 96
+    {MN_SUB, "A", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // 97
+    {MN_SBB, "B", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 98
+    {MN_SBB, "C", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 99
+    {MN_SBB, "D", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 9a
+    {MN_SBB, "E", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 9b
+    {MN_SBB, "H", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 9c
+    {MN_SBB, "L", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 9d
+    {MN_SBB, "M", 1, 7, 7, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 9e
+    {MN_SBB, "A", 1, 4, 4, FLAG_CY, FLAGS_ALL, FLOW_NONE},                 // 9f
+
+    {MN_ANA, "B", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a0
+    {MN_ANA, "C", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a1
+    {MN_ANA, "D", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a2
+    {MN_ANA, "E", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a3
+    {MN_ANA, "H", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a4
+    {MN_ANA, "L", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a5
+    {MN_ANA, "M", 1, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                       // a6
+    {MN_ANA, "A", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a7
+    {MN_XRA, "B", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a8
+    {MN_XRA, "C", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // a9
+    {MN_XRA, "D", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // aa
+    {MN_XRA, "E", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // ab
+    {MN_XRA, "H", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // ac
+    {MN_XRA, "L", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // ad
+    {MN_XRA, "M", 1, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                       // ae
+    {MN_XRA, "A", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // af
+
+    {MN_ORA, "B", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b0
+    {MN_ORA, "C", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b1
+    {MN_ORA, "D", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b2
+    {MN_ORA, "E", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b3
+    {MN_ORA, "H", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b4
+    {MN_ORA, "L", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b5
+    {MN_ORA, "M", 1, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                       // b6
+    {MN_ORA, "A", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b7
+    {MN_CMP, "B", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b8
+    {MN_CMP, "C", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // b9
+    {MN_CMP, "D", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // ba
+    {MN_CMP, "E", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // bb
+    {MN_CMP, "H", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // bc
+    {MN_CMP, "L", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // bd
+    {MN_CMP, "M", 1, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                       // be
+    {MN_CMP, "A", 1, 4, 4, 0, FLAGS_ALL, FLOW_NONE},                       // bf
+
+    {MN_RNZ, "", 1, 11, 5, FLAG_Z, 0, FLOW_CONDITIONAL_RETURN},            // c0
+    {MN_POP, "B", 1, 10, 10, 0, 0, FLOW_NONE},                             // c1
+    {MN_JNZ, "$", 3, 10, 10, FLAG_Z, 0, FLOW_BRANCH},                      // c2
+    {MN_JMP, "$", 3, 10, 10, 0, 0, FLOW_JUMP},                             // c3
+    {MN_CNZ, "$", 3, 17, 11, FLAG_Z, 0, FLOW_CONDITIONAL_CALL},            // c4
+    {MN_PUSH, "B", 1, 11, 11, 0, 0, FLOW_NONE},                            // c5
+    {MN_ADI, "#$", 2, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                      // c6
+    {MN_RST, "0", 1, 11, 11, 0, 0, FLOW_RST},                              // c7
+    {MN_RZ, "", 1, 11, 5, FLAG_Z, 0, FLOW_CONDITIONAL_RETURN},             // c8
+    {MN_RET, "", 1, 10, 10, 0, 0, FLOW_RETURN},                            // c9
+    {MN_JZ, "$", 3, 10, 10, FLAG_Z, 0, FLOW_BRANCH},                       // ca
+    {MN_JMP, "$", 3, 10, 10, 0, 0, FLOW_JUMP},                             // cb
+    {MN_CZ, "$", 3, 17, 11, FLAG_Z, 0, FLOW_CONDITIONAL_CALL},             // cc
+    {MN_CALL, "$", 3, 17, 17, 0, 0, FLOW_CALL},                            // cd
+    {MN_ACI, "#$", 2, 7, 7, FLAG_CY, FLAGS_ALL, FLOW_NONE},                // ce
+    {MN_RST, "1", 1, 11, 11, 0, 0, FLOW_RST},                              // cf
+
+    {MN_RNC, "", 1, 11, 5, FLAG_CY, 0, FLOW_CONDITIONAL_RETURN},           // d0
+    {MN_POP, "D", 1, 10, 10, 0, 0, FLOW_NONE},                             // d1
+    {MN_JNC, "$", 3, 10, 10, FLAG_CY, 0, FLOW_BRANCH},                     // d2
+    {MN_OUT, "#$", 2, 10, 10, 0, 0, FLOW_NONE},                            // d3
+    {MN_CNC, "$", 3, 17, 11, FLAG_CY, 0, FLOW_CONDITIONAL_CALL},           // d4
+    {MN_PUSH, "D", 1, 11, 11, 0, 0, FLOW_NONE},                            // d5
+    {MN_SUI, "#$", 2, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                      // d6
+    {MN_RST, "2", 1, 11, 11, 0, 0, FLOW_RST},                              // d7
+    {MN_RC, "", 1, 11, 5, FLAG_CY, 0, FLOW_CONDITIONAL_RETURN},            // d8
+    {MN_RET, "", 1, 10, 10, 0, 0, FLOW_RETURN},                            // d9
+    {MN_JC, "$", 3, 10, 10, FLAG_CY, 0, FLOW_BRANCH},                      // da
+    {MN_IN, "#$", 2, 10, 10, 0, 0, FLOW_NONE},                             // db
+    {MN_CC, "$", 3, 17, 11, FLAG_CY, 0, FLOW_CONDITIONAL_CALL},            // dc
+    {MN_CALL, "$", 3, 17, 17, 0, 0, FLOW_CALL},                            // dd
+    {MN_SBI, "#$", 2, 7, 7, FLAG_CY, FLAGS_ALL, FLOW_NONE},                // de
+    {MN_RST, "3", 1, 11, 11, 0, 0, FLOW_RST},                              // df
+
+    {MN_RPO, "", 1, 11, 5, FLAG_P, 0, FLOW_CONDITIONAL_RETURN},            // e0
+    {MN_POP, "H", 1, 10, 10, 0, 0, FLOW_NONE},                             // e1
+    {MN_JPO, "$", 3, 10, 10, FLAG_P, 0, FLOW_BRANCH},                      // e2
+    {MN_XTHL, "", 1, 18, 18, 0, 0, FLOW_NONE},                             // e3
+    {MN_CPO, "$", 3, 17, 11, FLAG_P, 0, FLOW_CONDITIONAL_CALL},            // e4
+    {MN_PUSH, "H", 1, 11, 11, 0, 0, FLOW_NONE},                            // e5
+    {MN_ANI, "#$", 2, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                      // e6
+    {MN_RST, "4", 1, 11, 11, 0, 0, FLOW_RST},                              // e7
+    {MN_RPE, "", 1, 11, 5, FLAG_P, 0, FLOW_CONDITIONAL_RETURN},            // e8
+    {MN_PCHL, "", 1, 5, 5, 0, 0, FLOW_INDIRECT},                           // e9
+    {MN_JPE, "$", 3, 10, 10, FLAG_P, 0, FLOW_BRANCH},                      // ea
+    {MN_XCHG, "", 1, 4, 4, 0, 0, FLOW_NONE},                               // eb
+    {MN_CPE, "$", 3, 17, 11, FLAG_P, 0, FLOW_CONDITIONAL_CALL},            // ec
+    {MN_CALL, "$", 3, 17, 17, 0, 0, FLOW_CALL},                            // ed
+    {MN_XRI, "#$", 2, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                      // ee
+    {MN_RST, "5", 1, 11, 11, 0, 0, FLOW_RST},                              // ef
+
+    {MN_RP, "", 1, 11, 5, FLAG_S, 0, FLOW_CONDITIONAL_RETURN},             // f0
+    {MN_POP, "PSW", 1, 10, 10, 0, FLAGS_ALL, FLOW_NONE},                   // f1
+    {MN_JP, "$", 3, 10, 10, FLAG_S, 0, FLOW_BRANCH},                       // f2
+    {MN_DI, "", 1, 4, 4, 0, 0, FLOW_NONE},                                 // f3
+    {MN_CP, "$", 3, 17, 11, FLAG_S, 0, FLOW_CONDITIONAL_CALL},             // f4
+    {MN_PUSH, "PSW", 1, 11, 11, FLAGS_ALL, 0, FLOW_NONE},                  // f5
+    {MN_ORI, "#$", 2, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                      // f6
+    {MN_RST, "6", 1, 11, 11, 0, 0, FLOW_RST},                              // f7
+    {MN_RM, "", 1, 11, 5, FLAG_S, 0, FLOW_CONDITIONAL_RETURN},             // f8
+    {MN_SPHL, "", 1, 5, 5, 0, 0, FLOW_NONE},                               // f9
+    {MN_JM, "$", 3, 10, 10, FLAG_S, 0, FLOW_BRANCH},                       // fa
+    {MN_EI, "", 1, 4, 4, 0, 0, FLOW_NONE},                                 // fb
+    {MN_CM, "$", 3, 17, 11, FLAG_S, 0, FLOW_CONDITIONAL_CALL},             // fc
+    {MN_CALL, "$", 3, 17, 17, 0, 0, FLOW_CALL},                            // fd
+    {MN_CPI, "#$", 2, 7, 7, 0, FLAGS_ALL, FLOW_NONE},                      // fe
+    {MN_RST, "7", 1, 11, 11, 0, 0, FLOW_RST},                              // ff
+};
+
+// The length of every op follows from its operand: a byte immediate or
+// port makes it 2, a word or address 3. Catches table edits that get it
+// wrong, which is the mistake MVI B used to have.
+constexpr bool LengthsConsistent()
+{
+    for (int op = 0; op < 256; op++)
+    {
+        const OpInfo8080& info = opinfo8080[op];
+        int expected = 1;
+        if (info.mnemonic == MN_MVI || info.mnemonic == MN_IN || info.mnemonic == MN_OUT ||
+            info.mnemonic == MN_ADI || info.mnemonic == MN_ACI || info.mnemonic == MN_SUI ||
+            info.mnemonic == MN_SBI || info.mnemonic == MN_ANI || info.mnemonic == MN_XRI ||
+            info.mnemonic == MN_ORI || info.mnemonic == MN_CPI)
+            expected = 2;
+        else if (info.mnemonic == MN_LXI || info.mnemonic == MN_STA || info.mnemonic == MN_LDA ||
+                 info.mnemonic == MN_SHLD || info.mnemonic == MN_LHLD ||
+                 info.flow == FLOW_JUMP || info.flow == FLOW_BRANCH ||
+                 info.flow == FLOW_CALL || info.flow == FLOW_CONDITIONAL_CALL)
+            expected = 3;
+        if (info.length != expected)
+            return false;
+    }
+    return true;
+}
+
+static_assert(LengthsConsistent(), "opinfo8080 has an instruction with the wrong length");
+
+// the cpu charges cycles up front and refunds the difference when a
+// condition fails, so that can't go negative; and every conditional call
+// and return costs the same
+constexpr bool CyclesConsistent()
+{
+    for (int op = 0; op < 256; op++)
+    {
+        const OpInfo8080& info = opinfo8080[op];
+        if (info.cycles < info.cycles_not_taken)
+            return false;
+        if (info.flow == FLOW_CONDITIONAL_CALL && (info.cycles != 17 || info.cycles_not_taken != 11))
+            return false;
+        if (info.flow == FLOW_CONDITIONAL_RETURN && (info.cycles != 11 || info.cycles_not_taken != 5))
+            return false;
+    }
+    return true;
+}
+
+static_assert(CyclesConsistent(), "opinfo8080 has an instruction with the wrong cycle count");
+
+#endif
@@ -0,0 +1,272 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include "functions.h"
+#include "machine.h"
+#include "profile.h"
+
+Profile8080* CreateProfile()
+{
+    return (Profile8080*) calloc(1, sizeof(Profile8080));
+}
+
+/*
+Finds the indices of the largest entries in counts, biggest first.
+
+returns how many of them are non-zero (at most top)
+*/
+static int TopEntries(const uint64_t* counts, int n, int* out, int top)
+{
+    int found = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (counts[i] == 0)
+            continue;
+        if (found == top && counts[i] <= counts[out[top - 1]])
+            continue;
+        int j = found < top ? found++ : top - 1;
+        while (j > 0 && counts[out[j - 1]] < counts[i])
+        {
+            out[j] = out[j - 1];
+            j--;
+        }
+        out[j] = i;
+    }
+    return found;
+}
+
+/*
+Prints the opcode histogram, the most frequent opcode pairs (candidates
+for superinstructions) and the hottest addresses with their disassembly.
+*/
+void PrintProfile(Profile8080* profile, unsigned char* memory, int top)
+{
+    uint64_t total = 0;
+    for (int i = 0; i < 256; i++)
+        total += profile->op_counts[i];
+    if (total == 0)
+        return;
+
+    int* idx = (int*) malloc(sizeof(int) * (top > 256 ? top : 256));
+
+    printf("opcodes (%llu instructions)\n", (unsigned long long) total);
+    int n = TopEntries(profile->op_counts, 256, idx, 256);
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t count = profile->op_counts[idx[i]];
+        unsigned char code[3] = {(unsigned char) idx[i], 0, 0};
+        Instruction8080 op;
+        Decode8080Op(code, &op);
+        printf("%10llu %6.2f%%  %02x %s\n", (unsigned long long) count, 100.0 * count / total,
+               idx[i], Mnemonic8080(op.mnemonic));
+    }
+
+    printf("\nopcode pairs\n");
+    n = TopEntries(profile->pair_counts, 0x10000, idx, top);
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t count = profile->pair_counts[idx[i]];
+        printf("%10llu %6.2f%%  %02x %02x\n", (unsigned long long) count, 100.0 * count / total,
+               idx[i] >> 8, idx[i] & 0xff);
+    }
+
+    printf("\nhot addresses\n");
+    n = TopEntries(profile->pc_counts, 0x10000, idx, top);
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t count = profile->pc_counts[idx[i]];
+        printf("%10llu %6.2f%%  ", (unsigned long long) count, 100.0 * count / total);
+        Disassemble8080Op(memory, idx[i]);
+    }
+
+    free(idx);
+}
+
+CallProfile8080* CreateCallProfile()
+{
+    CallProfile8080* calls = (CallProfile8080*) calloc(1, sizeof(CallProfile8080));
+    for (int i = 0; i < 9; i++)
+    {
+        calls->nodes[i].addr = i == CALL_ROOT_RESET ? 0 : (i - 1) * 8;
+        calls->nodes[i].parent = -1;
+        calls->nodes[i].child = -1;
+        calls->nodes[i].sibling = -1;
+    }
+    calls->nnodes = 9;
+    calls->current = CALL_ROOT_RESET;
+    calls->last_ns = MonotonicNs();
+    return calls;
+}
+
+// Charges everything since the last call/return to the running routine.
+static void Charge(CallProfile8080* calls, State8080* state)
+{
+    uint64_t now = MonotonicNs();
+    CallNode* node = &calls->nodes[calls->current];
+    node->cycles += state->cycles - calls->last_cycles;
+    node->ns += now - calls->last_ns;
+    calls->last_cycles = state->cycles;
+    calls->last_ns = now;
+}
+
+static int FindChild(CallProfile8080* calls, int parent, uint16_t addr)
+{
+    int n;
+    for (n = calls->nodes[parent].child; n != -1; n = calls->nodes[n].sibling)
+        if (calls->nodes[n].addr == addr)
+            return n;
+
+    // out of nodes, keep charging the caller
+    if (calls->nnodes == MAX_CALL_NODES)
+        return parent;
+
+    n = calls->nnodes++;
+    calls->nodes[n].addr = addr;
+    calls->nodes[n].parent = parent;
+    calls->nodes[n].child = -1;
+    calls->nodes[n].sibling = calls->nodes[parent].child;
+    calls->nodes[parent].child = n;
+    return n;
+}
+
+static void PushFrame(CallProfile8080* calls, State8080* state, int node)
+{
+    // too deep to track, the callee gets charged to the caller and the
+    // matching return finds nothing to pop
+    if (calls->depth == MAX_CALL_DEPTH)
+        return;
+    calls->stack[calls->depth].return_to = calls->current;
+    calls->stack[calls->depth].sp = state->sp;
+    calls->depth++;
+    calls->current = node;
+}
+
+void ProfileCall(CallProfile8080* calls, State8080* state)
+{
+    Charge(calls, state);
+    PushFrame(calls, state, FindChild(calls, calls->current, state->pc));
+}
+
+void ProfileReturn(CallProfile8080* calls, State8080* state, uint16_t sp_before)
+{
+    Charge(calls, state);
+    // pop the frame being returned from, plus any the program abandoned by
+    // moving sp past them without a RET
+    while (calls->depth > 0 && calls->stack[calls->depth - 1].sp <= sp_before)
+    {
+        calls->depth--;
+        calls->current = calls->stack[calls->depth].return_to;
+    }
+}
+
+void ProfileInterrupt(CallProfile8080* calls, State8080* state, int interrupt_num)
+{
+    Charge(calls, state);
+    PushFrame(calls, state, 1 + interrupt_num);
+}
+
+static void WritePath(CallProfile8080* calls, FILE* out, int n)
+{
+    CallNode* node = &calls->nodes[n];
+    if (node->parent == -1)
+    {
+        if (n == CALL_ROOT_RESET)
+            fprintf(out, "reset");
+        else
+            fprintf(out, "rst%d", n - 1);
+        return;
+    }
+    WritePath(calls, out, node->parent);
+    fprintf(out, ";%04x", node->addr);
+}
+
+/*
+Writes one "root;caller;callee value" line per call path with non-zero
+self time. value is emulated cycles, or host nanoseconds if host_time
+is set.
+*/
+void WriteFoldedStacks(CallProfile8080* calls, FILE* out, int host_time)
+{
+    for (int n = 0; n < calls->nnodes; n++)
+    {
+        uint64_t value = host_time ? calls->nodes[n].ns : calls->nodes[n].cycles;
+        if (value == 0)
+            continue;
+        WritePath(calls, out, n);
+        fprintf(out, " %llu\n", (unsigned long long) value);
+    }
+}
+
+MemoryHeatmap8080* CreateHeatmap(const char* prefix, int interval, int binary)
+{
+    MemoryHeatmap8080* heatmap = (MemoryHeatmap8080*) calloc(1, sizeof(MemoryHeatmap8080));
+    snprintf(heatmap->prefix, sizeof(heatmap->prefix), "%s", prefix);
+    heatmap->interval = interval;
+    heatmap->binary = binary;
+    return heatmap;
+}
+
+static const char* Region(int address)
+{
+    if (address < ROM_SIZE)
+        return "rom";
+    if (address < VRAM_START)
+        return "ram";
+    if (address < RAM_END)
+        return "vram";
+    return "mirror";
+}
+
+static void WriteCounts(FILE* f, const uint32_t* counts)
+{
+    uint8_t bytes[4];
+    for (int i = 0; i < 0x10000; i++)
+    {
+        bytes[0] = counts[i] & 0xff;
+        bytes[1] = (counts[i] >> 8) & 0xff;
+        bytes[2] = (counts[i] >> 16) & 0xff;
+        bytes[3] = (counts[i] >> 24) & 0xff;
+        fwrite(bytes, 4, 1, f);
+    }
+}
+
+/*
+Dumps the counts gathered since the last dump and clears them.
+*/
+void WriteHeatmap(MemoryHeatmap8080* heatmap)
+{
+    char filename[96];
+    snprintf(filename, sizeof(filename), "%s_%d.%s", heatmap->prefix, heatmap->dumps++,
+             heatmap->binary ? "bin" : "csv");
+    FILE* f = fopen(filename, heatmap->binary ? "wb" : "w");
+    if (f == NULL)
+    {
+        printf("error: Couldn't open %s\n", filename);
+        return;
+    }
+
+    if (heatmap->binary)
+    {
+        WriteCounts(f, heatmap->reads);
+        WriteCounts(f, heatmap->writes);
+    }
+    else
+    {
+        fprintf(f, "address,region,reads,writes\n");
+        for (int i = 0; i < 0x10000; i++)
+            if (heatmap->reads[i] || heatmap->writes[i])
+                fprintf(f, "%04x,%s,%u,%u\n", i, Region(i), heatmap->reads[i], heatmap->writes[i]);
+    }
+    fclose(f);
+
+    memset(heatmap->reads, 0, sizeof(heatmap->reads));
+    memset(heatmap->writes, 0, sizeof(heatmap->writes));
+    heatmap->frames = 0;
+}
+
+void HeatmapEndFrame(MemoryHeatmap8080* heatmap)
+{
+    if (++heatmap->frames >= heatmap->interval)
+        WriteHeatmap(heatmap);
+}
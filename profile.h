@@ -0,0 +1,108 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include "functions.h"
+#include "opcodes.h"
+
+// Execution counters for finding hot opcodes and hot code. The hook in
+// Emulate8080p only exists when the core is built with -DPROFILE_OPS=1,
+// so the normal build pays nothing for it.
+struct Profile8080 {
+    uint64_t op_counts[256];
+    uint64_t pc_counts[0x10000];
+    uint64_t pair_counts[0x10000];  // (previous opcode << 8) | opcode
+    uint8_t last_op;
+};
+
+static inline void ProfileOp(Profile8080* profile, uint16_t pc, uint8_t op)
+{
+    profile->op_counts[op]++;
+    profile->pc_counts[pc]++;
+    profile->pair_counts[(profile->last_op << 8) | op]++;
+    profile->last_op = op;
+}
+
+Profile8080* CreateProfile();
+void PrintProfile(Profile8080* profile, unsigned char* memory, int top);
+
+// Call graph profiling, built in with -DPROFILE_CALLS=1. A shadow stack
+// follows CALL/Ccc/RST and RET/Rcc so emulated cycles and host time can be
+// charged to the 8080 subroutine that was running, and dumped as folded
+// stacks for flamegraph.pl and friends. Interrupts start their own root.
+#define MAX_CALL_NODES 16384
+#define MAX_CALL_DEPTH 256
+#define CALL_ROOT_RESET 0           // node 0 is the reset entry, 1-8 are RST 0-7 interrupts
+
+struct CallNode {
+    uint16_t addr;
+    int parent;
+    int child;
+    int sibling;
+    uint64_t cycles;
+    uint64_t ns;
+};
+
+struct CallFrame {
+    int return_to;                  // node that was running when the call happened
+    uint16_t sp;                    // where the return address was pushed
+};
+
+struct CallProfile8080 {
+    CallNode nodes[MAX_CALL_NODES];
+    int nnodes;
+    CallFrame stack[MAX_CALL_DEPTH];
+    int depth;
+    int current;
+    uint64_t last_cycles;
+    uint64_t last_ns;
+};
+
+CallProfile8080* CreateCallProfile();
+void ProfileCall(CallProfile8080* calls, State8080* state);
+void ProfileReturn(CallProfile8080* calls, State8080* state, uint16_t sp_before);
+void ProfileInterrupt(CallProfile8080* calls, State8080* state, int interrupt_num);
+void WriteFoldedStacks(CallProfile8080* calls, FILE* out, int host_time);
+
+// Memory heatmap, built in with -DPROFILE_MEMORY=1. Counts every data
+// read and write the core makes. RunFrame hands the counts to
+// HeatmapEndFrame, which dumps and clears them every `interval` frames to
+// <prefix>_<n>.csv (address,region,reads,writes; untouched addresses are
+// skipped) or, with binary set, <prefix>_<n>.bin (the reads array then the
+// writes array, 65536 little endian uint32 each).
+struct MemoryHeatmap8080 {
+    uint32_t reads[0x10000];
+    uint32_t writes[0x10000];
+    int interval;
+    int frames;
+    int dumps;
+    int binary;
+    char prefix[64];
+};
+
+MemoryHeatmap8080* CreateHeatmap(const char* prefix, int interval, int binary);
+void HeatmapEndFrame(MemoryHeatmap8080* heatmap);
+void WriteHeatmap(MemoryHeatmap8080* heatmap);
+
+// Called after every instruction with the opcode and the stack pointer it
+// started with. Only taken calls and returns move sp by exactly 2 in the
+// right direction, so untaken Ccc/Rcc fall through here.
+static inline void ProfileCallsOp(CallProfile8080* calls, State8080* state, uint8_t op, uint16_t sp_before)
+{
+    int flow = opinfo8080[op].flow;
+    if (flow == FLOW_NONE)
+        return;
+    if (state->sp == (uint16_t) (sp_before - 2))
+    {
+        if (flow == FLOW_CALL || flow == FLOW_CONDITIONAL_CALL || flow == FLOW_RST)
+            ProfileCall(calls, state);
+    }
+    else if (state->sp == (uint16_t) (sp_before + 2))
+    {
+        if (flow == FLOW_RETURN || flow == FLOW_CONDITIONAL_RETURN)
+            ProfileReturn(calls, state, sp_before);
+    }
+}
+
+#endif
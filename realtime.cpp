@@ -0,0 +1,192 @@
+#include <cstdint>
+#include <cstring>
+#include <errno.h>
+#include <time.h>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "machine.h"
+#include "input.h"
+#include "realtime.h"
+
+static void SleepUntil(uint64_t deadline, uint64_t spin_ns)
+{
+    if (deadline > spin_ns + MonotonicNs())
+    {
+        uint64_t wake = deadline - spin_ns;
+        timespec at = {(time_t) (wake / 1000000000), (long) (wake % 1000000000)};
+        // a signal only cuts the sleep short; anything else and the spin
+        // below does the whole wait
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, NULL) == EINTR)
+            ;
+    }
+    while (MonotonicNs() < deadline)
+        ;
+}
+
+// Hands back to the presenter and takes the slot it last gave up.
+static void SwapBack(TripleBuffer8080* buffer)
+{
+    uint8_t old = buffer->middle.exchange(buffer->back | SLOT_FRESH, std::memory_order_acq_rel);
+    buffer->back = old & ~SLOT_FRESH;
+}
+
+/*
+Takes the newest finished slot, if there is one the presenter hasn't had.
+
+returns NULL if nothing new has arrived
+*/
+static const PresentSlot* SwapFront(TripleBuffer8080* buffer)
+{
+    if (!(buffer->middle.load(std::memory_order_relaxed) & SLOT_FRESH))
+        return NULL;
+    uint8_t old = buffer->middle.exchange(buffer->front, std::memory_order_acq_rel);
+    buffer->front = old & ~SLOT_FRESH;
+    return &buffer->slots[buffer->front];
+}
+
+static void CpuThread(Realtime8080* rt)
+{
+    State8080* state = rt->state;
+    uint64_t start = MonotonicNs();
+    uint64_t n = 0;
+    uint64_t input_ns = 0;
+    Stats8080* counters = &rt->counters;
+
+    while (!rt->quitting.load(std::memory_order_relaxed) && (rt->frames == 0 || (long) n < rt->frames))
+    {
+        uint64_t lap = MonotonicNs();
+        if (rt->inputs != NULL)
+        {
+            uint64_t pushed = DrainInputs(rt->inputs, rt->cabinet, n);
+            if (pushed != 0)
+                input_ns = pushed;
+        }
+        Lap(&counters->io_ns, &lap);
+
+        if (BeginRunAhead(&rt->ahead, state))
+            break;
+        PresentSlot* slot = &rt->buffer.slots[rt->buffer.back];
+        memcpy(&slot->memory[RAM_START], &state->memory[RAM_START], RAM_END - RAM_START);
+        slot->cycles = state->cycles;
+        EndRunAhead(&rt->ahead, state);
+        Lap(&counters->cpu_ns, &lap);
+        if (rt->hook != NULL)
+            rt->hook(state, rt->user);
+        Lap(&counters->io_ns, &lap);
+
+        counters->frames++;
+        CollectStats(counters, state);
+        slot->frame = n++;
+        slot->input_ns = input_ns;
+        slot->done_ns = MonotonicNs();
+        slot->stats = *counters;
+        SwapBack(&rt->buffer);
+        {
+            // so a presenter that just found nothing is asleep by now
+            std::lock_guard<std::mutex> guard(rt->lock);
+        }
+        rt->ready.notify_one();
+
+        // the pacing lands in the next frame's copy
+        uint64_t deadline = start + n * FRAME_NS;
+        counters->paced_frames++;
+        if (slot->done_ns > deadline)
+        {
+            // fell behind: start the schedule again from here rather than
+            // run frames back to back to catch up
+            counters->overruns++;
+            start = slot->done_ns - n * FRAME_NS;
+            continue;
+        }
+        SleepUntil(deadline, rt->spin_ns);
+        uint64_t late = MonotonicNs() - deadline;
+        counters->jitter_total_ns += late;
+        if (late > counters->jitter_max_ns)
+            counters->jitter_max_ns = late;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(rt->lock);
+        rt->finished.store(1, std::memory_order_release);
+    }
+    rt->ready.notify_one();
+}
+
+/*
+Starts running state, which must have a cabinet attached, in real time
+for frames frames (0 for until StopRealtime). run_ahead is as for invaders
+-r; inputs, if not NULL, is drained before every frame; hook, if not
+NULL, gets every frame on the cpu thread.
+
+returns the running machine, to be freed with DestroyRealtime
+*/
+Realtime8080* StartRealtime(State8080* state, long frames, uint64_t spin_ns, int run_ahead,
+                            InputQueue8080* inputs, FrameHook8080 hook, void* user)
+{
+    Realtime8080* rt = new Realtime8080();
+    rt->state = state;
+    rt->cabinet = (Cabinet8080*) state->io;
+    rt->frames = frames;
+    rt->spin_ns = spin_ns;
+    InitRunAhead(&rt->ahead, run_ahead);
+    rt->inputs = inputs;
+    rt->hook = hook;
+    rt->user = user;
+    rt->buffer.back = 0;
+    rt->buffer.middle.store(1);
+    rt->buffer.front = 2;
+    rt->cpu = std::thread(CpuThread, rt);
+    return rt;
+}
+
+/*
+Waits up to timeout_ms for a frame newer than the last one returned. The
+slot stays valid until the next call.
+
+returns NULL on timeout, or once the cpu thread has stopped (rt->finished)
+*/
+const PresentSlot* WaitFrame(Realtime8080* rt, int timeout_ms)
+{
+    const PresentSlot* slot = SwapFront(&rt->buffer);
+    if (slot == NULL)
+    {
+        std::unique_lock<std::mutex> guard(rt->lock);
+        rt->ready.wait_for(guard, std::chrono::milliseconds(timeout_ms), [&] {
+            return (rt->buffer.middle.load(std::memory_order_relaxed) & SLOT_FRESH) ||
+                   rt->finished.load(std::memory_order_relaxed);
+        });
+        slot = SwapFront(&rt->buffer);
+        if (slot == NULL)
+            return NULL;
+    }
+
+    Stats8080* stats = &rt->shown;
+    stats->presented++;
+    if (slot->input_ns != rt->last_input_ns)
+    {
+        uint64_t latency = MonotonicNs() - slot->input_ns;
+        rt->last_input_ns = slot->input_ns;
+        stats->latency_count++;
+        stats->latency_total_ns += latency;
+        if (latency > stats->latency_max_ns)
+            stats->latency_max_ns = latency;
+    }
+    return slot;
+}
+
+// Stops the cpu thread, after which rt->counters can be read; state is
+// left where it got to.
+void StopRealtime(Realtime8080* rt)
+{
+    rt->quitting.store(1);
+    if (rt->cpu.joinable())
+        rt->cpu.join();
+}
+
+void DestroyRealtime(Realtime8080* rt)
+{
+    StopRealtime(rt);
+    delete rt;
+}
@@ -0,0 +1,81 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "functions.h"
+#include "machine.h"
+#include "input.h"
+#include "stats.h"
+
+// Runs the machine at the real 60Hz on a thread of its own. Each frame has
+// an absolute deadline on CLOCK_MONOTONIC, start + n / 60s, so sleeping
+// never adds up to drift: the cpu thread runs the frame, sleeps with
+// clock_nanosleep(TIMER_ABSTIME) until spin_ns short of the deadline, and
+// spins the rest of the way, since the kernel often wakes a sleeper late
+// by more than the spin costs. Finished frames go to whoever presents them
+// through a triple buffer, so neither side ever waits on the other: the
+// cpu thread always has a slot to write, and the presenter always gets the
+// newest frame, skipping any it was too slow for.
+
+#define REALTIME_SPIN_NS    200000      // default spin tail
+#define FRAME_NS            (1000000000ull / FRAMES_PER_SECOND)
+
+// One finished frame, enough to publish, stream or render it.
+struct PresentSlot {
+    uint8_t memory[RAM_END];        // only RAM_START and up is filled in
+    uint64_t frame;
+    uint64_t cycles;
+    uint64_t done_ns;               // when the cpu thread finished it
+    uint64_t input_ns;              // when the newest input it ran with was pushed
+    Stats8080 stats;                // the cpu thread's counters as of this frame
+};
+
+// The cpu thread owns back, the presenter front, and they swap slots
+// through middle, whose FRESH bit says it holds a frame not yet taken.
+#define SLOT_FRESH          0x80
+
+struct TripleBuffer8080 {
+    PresentSlot slots[3];
+    std::atomic<uint8_t> middle;
+    uint8_t back;
+    uint8_t front;
+};
+
+// Runs on the cpu thread after every frame, for work that has to see all
+// of them, such as mixing the frame's sound.
+typedef void (*FrameHook8080)(State8080* state, void* user);
+
+struct Realtime8080 {
+    State8080* state;
+    Cabinet8080* cabinet;
+    long frames;                    // stop after this many, 0 to run on
+    uint64_t spin_ns;
+    RunAhead8080 ahead;
+    InputQueue8080* inputs;
+    FrameHook8080 hook;
+    void* user;
+
+    TripleBuffer8080 buffer;
+    std::thread cpu;
+    std::mutex lock;                // only for sleeping in WaitFrame
+    std::condition_variable ready;
+    std::atomic<int> quitting;
+    std::atomic<int> finished;
+
+    Stats8080 counters;             // the cpu thread's, only safe to read once
+                                    // finished; each frame has a copy
+    Stats8080 shown;                // the presenter's, latency and frames presented
+    uint64_t last_input_ns;         // presenter's
+};
+
+Realtime8080* StartRealtime(State8080* state, long frames, uint64_t spin_ns, int run_ahead,
+                            InputQueue8080* inputs, FrameHook8080 hook, void* user);
+const PresentSlot* WaitFrame(Realtime8080* rt, int timeout_ms);
+void StopRealtime(Realtime8080* rt);
+void DestroyRealtime(Realtime8080* rt);
+
+#endif
@@ -0,0 +1,63 @@
+/*
+Recursive descent disassembler for the ROM. Follows control flow from the
+reset and interrupt vectors, separates code from data and prints a listing,
+a Graphviz graph of the basic blocks, or the blocks as JSON.
+
+    g++ -O2 -DPRINTOPS=0 romcfg.cpp analysis.cpp disassembler.cpp 8080cpu.cpp -o romcfg
+
+usage: romcfg [-f listing|dot|json] [rom]
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <chrono>
+#include "functions.h"
+#include "i8080.h"
+#include "machine.h"
+#include "analysis.h"
+
+int main(int argc, char** argv)
+{
+    const char* rom = "invaders";
+    const char* format = "listing";
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            format = argv[++i];
+        else
+            rom = argv[i];
+    }
+
+    State8080* state = Init8080();
+    if (state == NULL)
+        return 1;
+    int status = ReadFileIntoMemoryAt(state, rom, 0);
+    if (status != STATUS_OK)
+    {
+        fprintf(stderr, "error: %s: %s\n", rom, StatusString8080(status));
+        return 1;
+    }
+
+    // reset, and the two interrupts the video hardware raises
+    uint16_t entries[] = {0x0000, 0x0008, 0x0010};
+    static CodeMap8080 map;
+
+    auto start = std::chrono::steady_clock::now();
+    AnalyzeCode(state->memory, ROM_SIZE, entries, 3, &map);
+    std::chrono::duration<double> secs = std::chrono::steady_clock::now() - start;
+    fprintf(stderr, "%d blocks in %.3f ms\n", map.nblocks, secs.count() * 1000);
+
+    static uint8_t dead[0x10000];
+    fprintf(stderr, "%d instructions with dead flags\n", FindDeadFlags(&map, state->memory, dead));
+
+    if (strcmp(format, "dot") == 0)
+        WriteDot(&map, stdout);
+    else if (strcmp(format, "json") == 0)
+        WriteJson(&map, stdout);
+    else
+        WriteListing(&map, state->memory, stdout);
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "i8080.h"
+#include "machine.h"
+#include "romset.h"
+
+// MAME's invaders set
+static constexpr RomPart8080 invaders_parts[] = {
+    {"invaders.h", 0x0000, 0x800, 0x734f5ad8, "ff6200af4c9110d8181249cbcef1a8a40fa40b7f"},
+    {"invaders.g", 0x0800, 0x800, 0x6bfaca4a, "16f48649b531bdef8c2d1446c429b5f414524350"},
+    {"invaders.f", 0x1000, 0x800, 0x0ccead96, "537aef03468f63c5b9e11dd61e253f7ae17d9743"},
+    {"invaders.e", 0x1800, 0x800, 0x14e538b0, "1d6ca0c99f9df71e2990b610deb9d7da0125e2d8"},
+};
+#define ROM_PARTS   (sizeof(invaders_parts) / sizeof(invaders_parts[0]))
+
+#if EMBED_ROM
+static constexpr uint8_t embedded_rom[] = {
+#include "invaders.inc"
+};
+
+// Crc32 without the table, for the compiler to run
+static constexpr uint32_t SlowCrc32(const uint8_t* data, size_t size)
+{
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++)
+            crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+    }
+    return crc ^ 0xffffffff;
+}
+
+static constexpr int EmbeddedVerified()
+{
+    if (sizeof(embedded_rom) != ROM_SIZE)
+        return 0;
+    for (const RomPart8080& part : invaders_parts)
+        if (SlowCrc32(&embedded_rom[part.offset], part.size) != part.crc32)
+            return 0;
+    return 1;
+}
+#endif
+
+struct Crc32Table {
+    uint32_t entries[256];
+};
+
+static constexpr Crc32Table MakeCrc32Table()
+{
+    Crc32Table table = {};
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        table.entries[i] = c;
+    }
+    return table;
+}
+
+// built by the compiler, so threads opening ROMs at once share it safely
+static constexpr Crc32Table crc32_table = MakeCrc32Table();
+
+uint32_t Crc32(const uint8_t* data, size_t size)
+{
+    const uint32_t* table = crc32_table.entries;
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return crc ^ 0xffffffff;
+}
+
+static uint32_t Rol(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+static void Sha1Block(uint32_t h[5], const uint8_t* block)
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++)
+        w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) | (block[i * 4 + 2] << 8) | block[i * 4 + 3];
+    for (int i = 16; i < 80; i++)
+        w[i] = Rol(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5a827999; }
+        else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ed9eba1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8f1bbcdc; }
+        else             { f = b ^ c ^ d;                   k = 0xca62c1d6; }
+        uint32_t t = Rol(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = Rol(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+void Sha1(const uint8_t* data, size_t size, uint8_t digest[20])
+{
+    uint32_t h[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+    size_t whole = size & ~(size_t) 63;
+    for (size_t at = 0; at < whole; at += 64)
+        Sha1Block(h, data + at);
+
+    // the tail, a 1 bit, zeros, and the length in bits
+    uint8_t last[128] = {0};
+    size_t tail = size - whole;
+    memcpy(last, data + whole, tail);
+    last[tail] = 0x80;
+    size_t blocks = tail + 9 > 64 ? 2 : 1;
+    uint64_t bits = (uint64_t) size * 8;
+    for (int i = 0; i < 8; i++)
+        last[blocks * 64 - 1 - i] = bits >> (i * 8);
+    for (size_t i = 0; i < blocks; i++)
+        Sha1Block(h, last + i * 64);
+
+    for (int i = 0; i < 20; i++)
+        digest[i] = h[i / 4] >> (24 - (i % 4) * 8);
+}
+
+static int PartMatches(const RomPart8080* part, const uint8_t* data)
+{
+    if (Crc32(data, part->size) != part->crc32)
+        return 0;
+    uint8_t digest[20];
+    char hex[41];
+    Sha1(data, part->size, digest);
+    for (int i = 0; i < 20; i++)
+        snprintf(&hex[i * 2], 3, "%02x", digest[i]);
+    return strcmp(hex, part->sha1) == 0;
+}
+
+/*
+Maps filename read-only.
+
+returns the mapping and its size in *size, or NULL with the reason in
+*status (STATUS_TOO_BIG if it is bigger than max)
+*/
+static void* MapFile(const char* filename, size_t max, size_t* size, int* status)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        *status = STATUS_OPEN_FAILED;
+        return NULL;
+    }
+    struct stat info;
+    void* map = NULL;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+        *status = STATUS_READ_FAILED;
+    else if ((size_t) info.st_size > max)
+        *status = STATUS_TOO_BIG;
+    else if ((map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        map = NULL;
+        *status = STATUS_READ_FAILED;
+    }
+    else
+    {
+        *size = info.st_size;
+        *status = STATUS_OK;
+    }
+    close(fd);
+    return map;
+}
+
+static int OpenSplitSet(const char* directory, int strict, RomSet8080* rom)
+{
+    rom->copy = (uint8_t*) calloc(ROM_SIZE, 1);
+    rom->image = rom->copy;
+    rom->size = ROM_SIZE;
+    rom->verified = 1;
+    for (size_t i = 0; i < ROM_PARTS; i++)
+    {
+        const RomPart8080* part = &invaders_parts[i];
+        char filename[1024];
+        snprintf(filename, sizeof(filename), "%s/%s", directory, part->name);
+
+        size_t size;
+        int status;
+        uint8_t* data = (uint8_t*) MapFile(filename, part->size, &size, &status);
+        if (data == NULL)
+            return status;
+        if (size != part->size || !PartMatches(part, data))
+            rom->verified = 0;
+        memcpy(&rom->copy[part->offset], data, size);
+        munmap(data, size);
+        if (!rom->verified && strict)
+            return STATUS_BAD_ROM;
+    }
+    return STATUS_OK;
+}
+
+static int OpenMerged(const char* filename, int strict, RomSet8080* rom)
+{
+    int status;
+    rom->map = MapFile(filename, 0x10000, &rom->size, &status);
+    if (rom->map == NULL)
+        return status;
+    rom->image = (const uint8_t*) rom->map;
+
+    rom->verified = rom->size == ROM_SIZE;
+    for (size_t i = 0; i < ROM_PARTS && rom->verified; i++)
+        rom->verified = PartMatches(&invaders_parts[i], &rom->image[invaders_parts[i].offset]);
+    return rom->verified || !strict ? STATUS_OK : STATUS_BAD_ROM;
+}
+
+/*
+Opens path, a directory with the split set or a merged file. With strict
+set, anything that isn't the known set is refused; otherwise it loads
+(up to 64K) with rom->verified clear, for hacks and homebrew.
+
+returns STATUS_OK, or why not, with nothing left to close
+*/
+int OpenRomSet(const char* path, int strict, RomSet8080* rom)
+{
+    memset(rom, 0, sizeof(*rom));
+    struct stat info;
+    if (stat(path, &info) != 0)
+        return STATUS_OPEN_FAILED;
+
+    int status = S_ISDIR(info.st_mode) ? OpenSplitSet(path, strict, rom) : OpenMerged(path, strict, rom);
+    if (status != STATUS_OK)
+        CloseRomSet(rom);
+    return status;
+}
+
+/*
+Opens the ROM compiled in with -DEMBED_ROM=1. verified comes from
+checksums taken at compile time, CRC32 only.
+
+returns STATUS_OK, or STATUS_OPEN_FAILED if there isn't one
+*/
+int OpenEmbeddedRom(RomSet8080* rom)
+{
+    memset(rom, 0, sizeof(*rom));
+#if EMBED_ROM
+    constexpr int verified = EmbeddedVerified();
+    rom->image = embedded_rom;
+    rom->size = sizeof(embedded_rom);
+    rom->verified = verified;
+    return STATUS_OK;
+#else
+    return STATUS_OPEN_FAILED;
+#endif
+}
+
+// Copies the ROM into state's memory from 0x0000.
+void InstallRom(const RomSet8080* rom, State8080* state)
+{
+    memcpy(state->memory, rom->image, rom->size);
+}
+
+void CloseRomSet(RomSet8080* rom)
+{
+    if (rom->map != NULL)
+        munmap(rom->map, rom->size);
+    free(rom->copy);
+    memset(rom, 0, sizeof(*rom));
+}
@@ -0,0 +1,54 @@
+#ifndef ROMSET_H
+#define ROMSET_H
+
+#include <cstdint>
+#include <cstddef>
+#include "functions.h"
+#include "machine.h"
+
+// Loads Space Invaders either as the usual split set, a directory holding
+// invaders.h, .g, .f and .e (2K each, at 0x0000, 0x0800, 0x1000, 0x1800),
+// or as one merged 8K file, checking every part's CRC32 and SHA1 against
+// the known dumps. Files are mmapped read-only, so every process on the
+// host reads them from the same page cache pages, and a merged file is
+// used in place without a copy. One RomSet8080 serves any number of
+// machines in a process; each gets the ROM with InstallRom, an 8K copy,
+// since the core addresses one flat 64K per machine.
+//
+// For jobs where even opening a file at startup shows, the ROM can be
+// compiled in, generated from the file as part of the build:
+//
+//     xxd -i < invaders > invaders.inc
+//     g++ ... -DEMBED_ROM=1 romset.cpp ...
+//
+// OpenEmbeddedRom then hands out the array with no I/O at all, and its
+// checksums are worked out by the compiler instead of at startup.
+
+#ifndef EMBED_ROM
+#define EMBED_ROM 0
+#endif
+
+struct RomPart8080 {
+    const char* name;
+    uint16_t offset;
+    uint16_t size;
+    uint32_t crc32;
+    const char* sha1;               // hex
+};
+
+struct RomSet8080 {
+    const uint8_t* image;           // the ROM as the cpu sees it from 0x0000
+    size_t size;
+    int verified;                   // every part matched the table
+    void* map;                      // a merged file's mapping, or NULL
+    uint8_t* copy;                  // a split set put together, or NULL
+};
+
+uint32_t Crc32(const uint8_t* data, size_t size);
+void Sha1(const uint8_t* data, size_t size, uint8_t digest[20]);
+int OpenRomSet(const char* path, int strict, RomSet8080* rom);
+int OpenEmbeddedRom(RomSet8080* rom);
+void InstallRom(const RomSet8080* rom, State8080* state);
+void CloseRomSet(RomSet8080* rom);
+
+#endif
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <atomic>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "sharedframe.h"
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "the seqlock has to work across processes");
+
+/*
+Creates (or takes over) the segment called name, e.g. "/invaders-0".
+
+returns the mapped segment, or NULL if it couldn't be created
+*/
+SharedFrame8080* CreateSharedFrame(const char* name)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return NULL;
+    if (ftruncate(fd, sizeof(SharedFrame8080)) != 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    void* mapped = mmap(NULL, sizeof(SharedFrame8080), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // magic goes in last, readers that see it can trust the rest
+    SharedFrame8080* shared = (SharedFrame8080*) mapped;
+    shared->sequence.store(0, std::memory_order_relaxed);
+    shared->version = SHARED_FRAME_VERSION;
+    shared->width = SCREEN_WIDTH;
+    shared->height = SCREEN_HEIGHT;
+    shared->frame = 0;
+    shared->cycles = 0;
+    std::atomic_thread_fence(std::memory_order_release);
+    shared->magic = SHARED_FRAME_MAGIC;
+    return shared;
+}
+
+/*
+Renders straight into the segment, so the only copy is of RAM.
+*/
+void PublishFrame(SharedFrame8080* shared, const State8080* state)
+{
+    PublishMemory(shared, state->memory, state->cycles);
+}
+
+// The same from a copy of memory, RAM_END bytes or more.
+void PublishMemory(SharedFrame8080* shared, const uint8_t* memory, uint64_t cycles)
+{
+    uint32_t seq = shared->sequence.load(std::memory_order_relaxed);
+    shared->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy(shared->ram, &memory[RAM_START], sizeof(shared->ram));
+    RenderFrame(memory, shared->framebuffer);
+    shared->frame++;
+    shared->cycles = cycles;
+
+    shared->sequence.store(seq + 2, std::memory_order_release);
+}
+
+void DestroySharedFrame(SharedFrame8080* shared, const char* name)
+{
+    if (shared != NULL)
+        munmap(shared, sizeof(SharedFrame8080));
+    shm_unlink(name);
+}
+
+/*
+Maps an existing segment read-only.
+
+returns NULL if there is no such segment or it isn't one of ours
+*/
+const SharedFrame8080* OpenSharedFrame(const char* name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(SharedFrame8080))
+    {
+        close(fd);
+        return NULL;
+    }
+    void* mapped = mmap(NULL, sizeof(SharedFrame8080), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return NULL;
+
+    const SharedFrame8080* shared = (const SharedFrame8080*) mapped;
+    if (shared->magic != SHARED_FRAME_MAGIC || shared->version != SHARED_FRAME_VERSION)
+    {
+        munmap(mapped, sizeof(SharedFrame8080));
+        return NULL;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return shared;
+}
+
+void CloseSharedFrame(const SharedFrame8080* shared)
+{
+    munmap((void*) shared, sizeof(SharedFrame8080));
+}
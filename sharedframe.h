@@ -0,0 +1,63 @@
+#ifndef SHAREDFRAME_H
+#define SHAREDFRAME_H
+
+#include <cstdint>
+#include <atomic>
+#include "functions.h"
+#include "machine.h"
+
+// Publishes each frame into a POSIX shared-memory segment so other
+// processes on the host can watch the machine without pipes or copies.
+// The segment holds the rendered picture, all of RAM (VRAM included, at
+// VRAM_START - RAM_START) and a frame counter, guarded by a seqlock: the
+// writer makes sequence odd while it updates, readers check it didn't
+// change (and wasn't odd) across their read, and retry if it did.
+//
+//     uint32_t seq;
+//     do {
+//         seq = SharedFrameBegin(shared);
+//         ... use shared->framebuffer, shared->ram in place ...
+//     } while (SharedFrameRetry(shared, seq));
+//
+// Every instance gets its own segment by giving it its own name.
+
+#define SHARED_FRAME_MAGIC      0x30383038  // "8080"
+#define SHARED_FRAME_VERSION    1
+#define SHARED_FRAME_NAME_MAX   64
+
+struct SharedFrame8080 {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    std::atomic<uint32_t> sequence;     // odd while a frame is being written
+    uint32_t reserved;
+    uint64_t frame;                     // frames published so far
+    uint64_t cycles;                    // state->cycles at the last publish
+    uint8_t ram[RAM_END - RAM_START];
+    uint8_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+};
+
+SharedFrame8080* CreateSharedFrame(const char* name);
+void PublishFrame(SharedFrame8080* shared, const State8080* state);
+void PublishMemory(SharedFrame8080* shared, const uint8_t* memory, uint64_t cycles);
+void DestroySharedFrame(SharedFrame8080* shared, const char* name);
+
+const SharedFrame8080* OpenSharedFrame(const char* name);
+void CloseSharedFrame(const SharedFrame8080* shared);
+
+static inline uint32_t SharedFrameBegin(const SharedFrame8080* shared)
+{
+    uint32_t seq;
+    while ((seq = shared->sequence.load(std::memory_order_acquire)) & 1)
+        ;
+    return seq;
+}
+
+static inline int SharedFrameRetry(const SharedFrame8080* shared, uint32_t seq)
+{
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return shared->sequence.load(std::memory_order_relaxed) != seq;
+}
+
+#endif
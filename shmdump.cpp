@@ -0,0 +1,54 @@
+/*
+Reads a frame published by "invaders -s name" without stopping or slowing
+the emulator, and saves the picture as a PGM.
+
+    g++ -O2 -DPRINTOPS=0 shmdump.cpp sharedframe.cpp machine.cpp 8080cpu.cpp disassembler.cpp -o shmdump
+
+usage: shmdump name [out.pgm]
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "sharedframe.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: shmdump name [out.pgm]\n");
+        return 1;
+    }
+    const char* outname = argc > 2 ? argv[2] : "frame.pgm";
+
+    const SharedFrame8080* shared = OpenSharedFrame(argv[1]);
+    if (shared == NULL)
+    {
+        printf("error: Couldn't open shared memory %s\n", argv[1]);
+        return 1;
+    }
+
+    // the one copy, out of the segment and into our own buffer
+    static uint8_t framebuffer[SCREEN_WIDTH * SCREEN_HEIGHT];
+    uint64_t frame, cycles;
+    uint32_t seq;
+    do {
+        seq = SharedFrameBegin(shared);
+        memcpy(framebuffer, shared->framebuffer, sizeof(framebuffer));
+        frame = shared->frame;
+        cycles = shared->cycles;
+    } while (SharedFrameRetry(shared, seq));
+    CloseSharedFrame(shared);
+
+    FILE* out = fopen(outname, "wb");
+    if (out == NULL)
+    {
+        printf("error: Couldn't open %s\n", outname);
+        return 1;
+    }
+    fprintf(out, "P5 %d %d 255\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+    fwrite(framebuffer, 1, sizeof(framebuffer), out);
+    fclose(out);
+    printf("frame %llu, %llu cycles\n", (unsigned long long) frame, (unsigned long long) cycles);
+    return 0;
+}
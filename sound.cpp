@@ -0,0 +1,244 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include "machine.h"
+#include "sound.h"
+
+// which sample each latch bit plays, -1 for none
+static const int port3_samples[8] = {0, 1, 2, 3, 9, -1, -1, -1};
+static const int port5_samples[8] = {4, 5, 6, 7, 8, -1, -1, -1};
+
+#define UFO_SAMPLE      0
+#define AMP_ENABLE      0x20
+
+static uint32_t Read32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t Read16(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+/*
+Reads an uncompressed 8 or 16 bit WAV, keeping the first channel.
+
+returns 0 if the file is missing or not something we understand
+*/
+static int LoadWav(const char* filename, Sample8080* sample)
+{
+    FILE* f = fopen(filename, "rb");
+    if (f == NULL)
+        return 0;
+    fseek(f, 0L, SEEK_END);
+    long fsize = ftell(f);
+    fseek(f, 0L, SEEK_SET);
+    uint8_t* file = (uint8_t*) malloc(fsize > 0 ? fsize : 1);
+    long got = fread(file, 1, fsize, f);
+    fclose(f);
+
+    int ok = 0;
+    if (got == fsize && fsize >= 12 && memcmp(file, "RIFF", 4) == 0 && memcmp(file + 8, "WAVE", 4) == 0)
+    {
+        uint16_t format = 0, channels = 0, bits = 0;
+        uint32_t rate = 0;
+        for (long at = 12; at + 8 <= fsize; )
+        {
+            uint32_t size = Read32(file + at + 4);
+            const uint8_t* body = file + at + 8;
+            if (size > (uint32_t) (fsize - at - 8))
+                break;
+            if (memcmp(file + at, "fmt ", 4) == 0 && size >= 16)
+            {
+                format = Read16(body);
+                channels = Read16(body + 2);
+                rate = Read32(body + 4);
+                bits = Read16(body + 14);
+            }
+            else if (memcmp(file + at, "data", 4) == 0 && format == 1 && channels > 0 && rate > 0 &&
+                     (bits == 8 || bits == 16))
+            {
+                uint32_t frame = channels * bits / 8;
+                sample->length = size / frame;
+                sample->rate = rate;
+                sample->data = (int16_t*) malloc(sample->length * sizeof(int16_t) + 1);
+                for (uint32_t i = 0; i < sample->length; i++)
+                {
+                    const uint8_t* p = body + i * frame;
+                    sample->data[i] = bits == 8 ? (int16_t) ((p[0] - 128) * 256) : (int16_t) Read16(p);
+                }
+                ok = 1;
+                break;
+            }
+            at += 8 + size + (size & 1);
+        }
+    }
+    free(file);
+    return ok;
+}
+
+/*
+Loads directory/0.wav to 9.wav, any that are missing stay silent, and
+mixes at rate samples per second. loaded, if not NULL, gets how many
+were found.
+*/
+SoundMixer8080* CreateSoundMixer(const char* directory, uint32_t rate, int* loaded)
+{
+    SoundMixer8080* mixer = (SoundMixer8080*) calloc(1, sizeof(SoundMixer8080));
+    mixer->rate = rate;
+    int found = 0;
+    for (int i = 0; i < SOUND_SAMPLES; i++)
+    {
+        char filename[512];
+        snprintf(filename, sizeof(filename), "%s/%d.wav", directory, i);
+        if (LoadWav(filename, &mixer->samples[i]))
+        {
+            mixer->voices[i].step = ((uint64_t) mixer->samples[i].rate << 32) / rate;
+            found++;
+        }
+    }
+    if (loaded != NULL)
+        *loaded = found;
+    return mixer;
+}
+
+static void Latch(SoundMixer8080* mixer, const int* samples, uint8_t before, uint8_t after)
+{
+    uint8_t rising = after & ~before;
+    for (int bit = 0; bit < 8; bit++)
+    {
+        int s = samples[bit];
+        if (s < 0)
+            continue;
+        Voice8080* voice = &mixer->voices[s];
+        if (rising & (1 << bit))
+        {
+            voice->playing = mixer->samples[s].data != NULL;
+            voice->position = 0;
+        }
+        // the UFO drones on for as long as its bit is held
+        if (s == UFO_SAMPLE)
+        {
+            voice->loop = (after >> bit) & 1;
+            if (!voice->loop)
+                voice->playing = 0;
+        }
+    }
+}
+
+static void Apply(SoundMixer8080* mixer, const SoundEvent8080* event)
+{
+    if (event->port == 3)
+    {
+        Latch(mixer, port3_samples, mixer->port3, event->value);
+        mixer->port3 = event->value;
+    }
+    else if (event->port == 5)
+    {
+        Latch(mixer, port5_samples, mixer->port5, event->value);
+        mixer->port5 = event->value;
+    }
+}
+
+/*
+Mixes from where the last call left off up to end_cycles, starting each
+logged event's sounds at the sample it happened on. Call it once per
+frame with that frame's events, then clear them.
+
+returns the number of samples written to out, at most capacity
+*/
+int MixSound(SoundMixer8080* mixer, const SoundEvents8080* sound, uint64_t end_cycles,
+             int16_t* out, int capacity)
+{
+    uint64_t first = mixer->cycles * mixer->rate / CPU_HZ;
+    uint64_t last = end_cycles * mixer->rate / CPU_HZ;
+    int n = last > first ? (int) (last - first) : 0;
+    if (n > capacity)
+        n = capacity;
+
+    int e = 0;
+    for (int i = 0; i < n; i++)
+    {
+        while (e < sound->count && sound->events[e].cycles * mixer->rate / CPU_HZ <= first + i)
+            Apply(mixer, &sound->events[e++]);
+
+        int32_t mix = 0;
+        for (int v = 0; v < SOUND_SAMPLES; v++)
+        {
+            Voice8080* voice = &mixer->voices[v];
+            if (!voice->playing)
+                continue;
+            const Sample8080* sample = &mixer->samples[v];
+            uint32_t at = voice->position >> 32;
+            if (at >= sample->length)
+            {
+                if (!voice->loop)
+                {
+                    voice->playing = 0;
+                    continue;
+                }
+                voice->position = 0;
+                at = 0;
+            }
+            mix += sample->data[at];
+            voice->position += voice->step;
+        }
+
+        if (!(mixer->port3 & AMP_ENABLE))
+            mix = 0;
+        out[i] = mix > 32767 ? 32767 : mix < -32768 ? -32768 : mix;
+    }
+    while (e < sound->count)
+        Apply(mixer, &sound->events[e++]);
+
+    mixer->cycles = end_cycles;
+    return n;
+}
+
+static void Put32(uint8_t* p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void WavHeader(uint8_t* header, uint32_t rate, uint32_t samples)
+{
+    memcpy(header, "RIFF\0\0\0\0WAVEfmt \x10\0\0\0\x01\0\x01\0\0\0\0\0\0\0\0\0\x02\0\x10\0data", 40);
+    Put32(header + 4, 36 + samples * 2);
+    Put32(header + 24, rate);
+    Put32(header + 28, rate * 2);
+    Put32(header + 40, samples * 2);
+}
+
+/*
+Starts a 16 bit mono WAV, the sizes get filled in by CloseWav. The
+samples are written with fwrite as they are, so little-endian hosts only.
+
+returns NULL if the file couldn't be opened
+*/
+FILE* OpenWav(const char* filename, uint32_t rate)
+{
+    FILE* out = fopen(filename, "wb");
+    if (out == NULL)
+        return NULL;
+    uint8_t header[44];
+    WavHeader(header, rate, 0);
+    fwrite(header, 1, sizeof(header), out);
+    return out;
+}
+
+void CloseWav(FILE* out, uint32_t samples)
+{
+    uint8_t size[4];
+    Put32(size, 36 + samples * 2);
+    fseek(out, 4, SEEK_SET);
+    fwrite(size, 1, 4, out);
+    Put32(size, samples * 2);
+    fseek(out, 40, SEEK_SET);
+    fwrite(size, 1, 4, out);
+    fclose(out);
+}
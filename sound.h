@@ -0,0 +1,75 @@
+#ifndef SOUND_H
+#define SOUND_H
+
+#include <cstdint>
+#include <cstdio>
+
+// Space Invaders has no sound chip, just discrete circuits switched on and
+// off by bits in two output latches. The cpu loop only logs latch changes
+// with their cycle time; MixSound turns a frame's worth of them into PCM
+// afterwards, playing the usual sample set (0.wav - 9.wav, as MAME names
+// them) for each bit that goes high.
+//
+//   port 3: bit 0 UFO (repeats while set), 1 shot, 2 player dies,
+//           3 invader dies, 4 extra life, 5 amplifier on
+//   port 5: bits 0-3 the four fleet movement notes, 4 UFO hit
+
+#define SOUND_EVENTS_MAX    256     // per frame, the game makes a handful
+#define SOUND_SAMPLES       10
+#define SOUND_RATE          44100
+
+struct SoundEvent8080 {
+    uint64_t cycles;
+    uint8_t port;
+    uint8_t value;
+};
+
+struct SoundEvents8080 {
+    SoundEvent8080 events[SOUND_EVENTS_MAX];
+    int count;
+    uint64_t dropped;
+};
+
+static inline void RecordSound(SoundEvents8080* sound, uint64_t cycles, uint8_t port, uint8_t value)
+{
+    if (sound->count == SOUND_EVENTS_MAX)
+    {
+        sound->dropped++;
+        return;
+    }
+    SoundEvent8080* event = &sound->events[sound->count++];
+    event->cycles = cycles;
+    event->port = port;
+    event->value = value;
+}
+
+struct Sample8080 {
+    int16_t* data;                  // mono, NULL if the file wasn't there
+    uint32_t length;
+    uint32_t rate;
+};
+
+struct Voice8080 {
+    uint8_t playing;
+    uint8_t loop;
+    uint64_t position;              // into the sample, 32.32 fixed point
+    uint64_t step;
+};
+
+struct SoundMixer8080 {
+    Sample8080 samples[SOUND_SAMPLES];
+    Voice8080 voices[SOUND_SAMPLES];
+    uint32_t rate;
+    uint64_t cycles;                // emulated time mixed up to
+    uint8_t port3;
+    uint8_t port5;
+};
+
+SoundMixer8080* CreateSoundMixer(const char* directory, uint32_t rate, int* loaded);
+int MixSound(SoundMixer8080* mixer, const SoundEvents8080* sound, uint64_t end_cycles,
+             int16_t* out, int capacity);
+
+FILE* OpenWav(const char* filename, uint32_t rate);
+void CloseWav(FILE* out, uint32_t samples);
+
+#endif
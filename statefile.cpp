@@ -0,0 +1,363 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "i8080.h"
+#include "machine.h"
+#include "romset.h"
+#include "statefile.h"
+
+static_assert(sizeof(StateHeader8080) == 64, "the header is part of the format");
+static_assert(sizeof(StateSection8080) == 32, "the section table is part of the format");
+static_assert(sizeof(StateCpu8080) == 40, "StateCpu8080 is part of the format");
+static_assert(sizeof(StateCabinet8080) == 8, "StateCabinet8080 is part of the format");
+static_assert(__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "save states are mapped as they are, little-endian");
+
+#define SECTIONS_WRITTEN    3
+#define RAM_BYTES           (RAM_END - RAM_START)
+
+static size_t Align(size_t at)
+{
+    return (at + STATE_ALIGN - 1) & ~(size_t) (STATE_ALIGN - 1);
+}
+
+void HashRom(const uint8_t* memory, RomHash8080* hash)
+{
+    hash->crc32 = Crc32(memory, ROM_SIZE);
+    Sha1(memory, ROM_SIZE, hash->sha1);
+}
+
+/*
+PackBits: a control byte n below 128 is followed by n + 1 bytes as they
+are, one above 128 by a byte to repeat 257 - n times. out needs room for
+size + size / 128 + 1 bytes.
+
+returns the encoded size
+*/
+static size_t EncodeRle(const uint8_t* in, size_t size, uint8_t* out)
+{
+    size_t o = 0;
+    for (size_t i = 0; i < size; )
+    {
+        size_t run = 1;
+        while (i + run < size && run < 128 && in[i + run] == in[i])
+            run++;
+        if (run >= 3)
+        {
+            out[o++] = (uint8_t) (257 - run);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+
+        // literals up to the next run of three
+        size_t start = i, n = 0;
+        while (i < size && n < 128 && !(i + 2 < size && in[i] == in[i + 1] && in[i] == in[i + 2]))
+        {
+            i++;
+            n++;
+        }
+        out[o++] = (uint8_t) (n - 1);
+        memcpy(&out[o], &in[start], n);
+        o += n;
+    }
+    return o;
+}
+
+// returns 1 if in expanded to exactly size bytes
+static int DecodeRle(const uint8_t* in, size_t size, uint8_t* out, size_t raw_size)
+{
+    size_t o = 0;
+    for (size_t i = 0; i < size; )
+    {
+        uint8_t n = in[i++];
+        if (n < 128)
+        {
+            if (i + n + 1 > size || o + n + 1 > raw_size)
+                return 0;
+            memcpy(&out[o], &in[i], n + 1);
+            i += n + 1;
+            o += n + 1;
+        }
+        else if (n > 128)
+        {
+            size_t run = 257 - n;
+            if (i >= size || o + run > raw_size)
+                return 0;
+            memset(&out[o], in[i++], run);
+            o += run;
+        }
+    }
+    return o == raw_size;
+}
+
+/*
+Saves state to filename, with the RAM run-length encoded if compress is
+set. rom is the ROM the state belongs to, see HashRom. Without a cabinet
+attached the cabinet section is all zeros.
+
+returns STATUS_OK, STATUS_OPEN_FAILED or STATUS_WRITE_FAILED, leaving any
+earlier file by that name as it was
+*/
+int WriteStateFile(const char* filename, const State8080* state, const RomHash8080* rom, int compress)
+{
+    StateCpu8080 cpu = {};
+    cpu.a = state->a;
+    cpu.flags = PackPSW(state) & 0xff;
+    cpu.b = state->b;
+    cpu.c = state->c;
+    cpu.d = state->d;
+    cpu.e = state->e;
+    cpu.h = state->h;
+    cpu.l = state->l;
+    cpu.sp = state->sp;
+    cpu.pc = state->pc;
+    cpu.int_enable = state->int_enable;
+    cpu.halted = state->halted;
+    cpu.cycles = state->cycles;
+    cpu.instructions = state->instructions;
+    cpu.interrupts = state->interrupts;
+
+    const Cabinet8080* live = (const Cabinet8080*) state->io;
+    StateCabinet8080 cabinet = {};
+    if (live != NULL)
+    {
+        cabinet.port1 = live->port1;
+        cabinet.port2 = live->port2;
+        cabinet.shift_offset = live->shift_offset;
+        cabinet.port3 = live->port3;
+        cabinet.port5 = live->port5;
+        cabinet.shift = live->shift;
+    }
+
+    static thread_local uint8_t packed[RAM_BYTES + RAM_BYTES / 128 + 1];
+    const uint8_t* ram = &state->memory[RAM_START];
+    size_t ram_size = RAM_BYTES;
+    if (compress)
+    {
+        ram_size = EncodeRle(ram, RAM_BYTES, packed);
+        ram = packed;
+    }
+
+    struct {
+        uint32_t id;
+        uint32_t flags;
+        const void* data;
+        size_t size;
+        size_t raw_size;
+    } parts[SECTIONS_WRITTEN] = {
+        {SECTION_CPU, 0, &cpu, sizeof(cpu), sizeof(cpu)},
+        {SECTION_RAM, compress ? STATE_RLE : 0u, ram, ram_size, RAM_BYTES},
+        {SECTION_CABINET, 0, &cabinet, sizeof(cabinet), sizeof(cabinet)},
+    };
+
+    // the whole file goes together in one buffer, one write
+    static thread_local uint8_t file[STATE_ALIGN * 8 + RAM_BYTES + RAM_BYTES / 128 + 1];
+    memset(file, 0, sizeof(file));
+    StateHeader8080* header = (StateHeader8080*) file;
+    StateSection8080* table = (StateSection8080*) (file + sizeof(StateHeader8080));
+    size_t at = Align(sizeof(StateHeader8080) + SECTIONS_WRITTEN * sizeof(StateSection8080));
+    for (int i = 0; i < SECTIONS_WRITTEN; i++)
+    {
+        table[i].id = parts[i].id;
+        table[i].flags = parts[i].flags;
+        table[i].offset = at;
+        table[i].size = parts[i].size;
+        table[i].raw_size = parts[i].raw_size;
+        memcpy(&file[at], parts[i].data, parts[i].size);
+        at = Align(at + parts[i].size);
+    }
+
+    header->magic = STATE_MAGIC;
+    header->version = STATE_VERSION;
+    header->sections = SECTIONS_WRITTEN;
+    header->rom_crc32 = rom->crc32;
+    memcpy(header->rom_sha1, rom->sha1, sizeof(header->rom_sha1));
+    header->cycles = state->cycles;
+    header->file_size = at;
+
+    char temp[1024];
+    if (snprintf(temp, sizeof(temp), "%s.tmp", filename) >= (int) sizeof(temp))
+        return STATUS_OPEN_FAILED;
+    FILE* out = fopen(temp, "wb");
+    if (out == NULL)
+        return STATUS_OPEN_FAILED;
+    int written = fwrite(file, 1, at, out) == at && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    written = fclose(out) == 0 && written;
+    if (!written || rename(temp, filename) != 0)
+    {
+        unlink(temp);
+        return STATUS_WRITE_FAILED;
+    }
+    return STATUS_OK;
+}
+
+// returns 1 if the header and every section lie within the file
+static int Valid(const StateFile8080* file)
+{
+    const StateHeader8080* header = file->header;
+    if (file->size < sizeof(StateHeader8080) || header->magic != STATE_MAGIC ||
+        header->version != STATE_VERSION || header->sections > STATE_SECTIONS_MAX ||
+        header->file_size != file->size ||
+        sizeof(StateHeader8080) + header->sections * sizeof(StateSection8080) > file->size)
+        return 0;
+    for (int i = 0; i < header->sections; i++)
+    {
+        const StateSection8080* section = &file->sections[i];
+        if (section->offset % STATE_ALIGN != 0 || section->offset > file->size ||
+            section->size > file->size - section->offset)
+            return 0;
+        if (!(section->flags & STATE_RLE) && section->size != section->raw_size)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+Maps filename read-only and checks its header and section table.
+
+returns STATUS_OK, or STATUS_OPEN_FAILED, STATUS_READ_FAILED or
+STATUS_BAD_FORMAT with nothing left to close
+*/
+int OpenStateFile(const char* filename, StateFile8080* file)
+{
+    memset(file, 0, sizeof(*file));
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return STATUS_OPEN_FAILED;
+    struct stat info;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &info) == 0 && info.st_size > 0)
+        map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return STATUS_READ_FAILED;
+
+    file->base = (const uint8_t*) map;
+    file->size = info.st_size;
+    file->header = (const StateHeader8080*) file->base;
+    file->sections = (const StateSection8080*) (file->base + sizeof(StateHeader8080));
+    if (!Valid(file))
+    {
+        CloseStateFile(file);
+        return STATUS_BAD_FORMAT;
+    }
+    return STATUS_OK;
+}
+
+// returns the table entry for id, or NULL if the file has no such section
+const StateSection8080* FindSection(const StateFile8080* file, uint32_t id)
+{
+    for (int i = 0; i < file->header->sections; i++)
+        if (file->sections[i].id == id)
+            return &file->sections[i];
+    return NULL;
+}
+
+/*
+The section in place, to cast to its struct.
+
+returns NULL if it is missing or compressed (use ReadSection then)
+*/
+const void* SectionData(const StateFile8080* file, uint32_t id)
+{
+    const StateSection8080* section = FindSection(file, id);
+    if (section == NULL || (section->flags & STATE_RLE))
+        return NULL;
+    return file->base + section->offset;
+}
+
+/*
+Copies section id, expanded, into out, which is size bytes.
+
+returns STATUS_OK, or STATUS_BAD_FORMAT if it's missing, the wrong size
+or doesn't expand
+*/
+int ReadSection(const StateFile8080* file, uint32_t id, void* out, size_t size)
+{
+    const StateSection8080* section = FindSection(file, id);
+    if (section == NULL || section->raw_size != size)
+        return STATUS_BAD_FORMAT;
+    const uint8_t* data = file->base + section->offset;
+    if (!(section->flags & STATE_RLE))
+    {
+        memcpy(out, data, size);
+        return STATUS_OK;
+    }
+    return DecodeRle(data, section->size, (uint8_t*) out, size) ? STATUS_OK : STATUS_BAD_FORMAT;
+}
+
+/*
+Puts the saved machine into state, leaving its memory pointer, hooks and
+work counters alone, and the cabinet's too if state has one attached.
+With rom set, a state saved under another ROM is refused.
+
+returns STATUS_OK, STATUS_BAD_ROM or STATUS_BAD_FORMAT; on an error
+state is unchanged
+*/
+int LoadStateFile(const StateFile8080* file, State8080* state, const RomHash8080* rom)
+{
+    const StateHeader8080* header = file->header;
+    if (rom != NULL &&
+        (header->rom_crc32 != rom->crc32 || memcmp(header->rom_sha1, rom->sha1, sizeof(rom->sha1)) != 0))
+        return STATUS_BAD_ROM;
+
+    StateCpu8080 cpu;
+    StateCabinet8080 cabinet;
+    int status = ReadSection(file, SECTION_CPU, &cpu, sizeof(cpu));
+    if (status == STATUS_OK)
+        status = ReadSection(file, SECTION_CABINET, &cabinet, sizeof(cabinet));
+    if (status != STATUS_OK)
+        return status;
+
+    // RAM comes straight from the mapping unless it has to be expanded
+    const uint8_t* ram = (const uint8_t*) SectionData(file, SECTION_RAM);
+    const StateSection8080* section = FindSection(file, SECTION_RAM);
+    if (section == NULL || section->raw_size != RAM_BYTES)
+        return STATUS_BAD_FORMAT;
+    if (ram == NULL)
+    {
+        static thread_local uint8_t expanded[RAM_BYTES];
+        if ((status = ReadSection(file, SECTION_RAM, expanded, sizeof(expanded))) != STATUS_OK)
+            return status;
+        ram = expanded;
+    }
+
+    // as POP PSW takes it
+    state->psw = (cpu.a << 8) | cpu.flags;
+    state->b = cpu.b;
+    state->c = cpu.c;
+    state->d = cpu.d;
+    state->e = cpu.e;
+    state->h = cpu.h;
+    state->l = cpu.l;
+    state->sp = cpu.sp;
+    state->pc = cpu.pc;
+    state->int_enable = cpu.int_enable;
+    state->halted = cpu.halted;
+    state->cycles = cpu.cycles;
+    memcpy(&state->memory[RAM_START], ram, RAM_BYTES);
+
+    Cabinet8080* live = (Cabinet8080*) state->io;
+    if (live != NULL)
+    {
+        live->port1 = cabinet.port1;
+        live->port2 = cabinet.port2;
+        live->shift_offset = cabinet.shift_offset;
+        live->port3 = cabinet.port3;
+        live->port5 = cabinet.port5;
+        live->shift = cabinet.shift;
+    }
+    return STATUS_OK;
+}
+
+void CloseStateFile(StateFile8080* file)
+{
+    if (file->base != NULL)
+        munmap((void*) file->base, file->size);
+    memset(file, 0, sizeof(*file));
+}
@@ -0,0 +1,118 @@
+#ifndef STATEFILE_H
+#define STATEFILE_H
+
+#include <cstdint>
+#include <cstddef>
+#include "functions.h"
+#include "machine.h"
+
+// Save states on disk, laid out so an uncompressed one can be mmapped and
+// used where it lies: a fixed header, then a table of sections, each
+// section starting on a STATE_ALIGN boundary and holding a plain struct
+// (or the RAM bytes) that a pointer into the mapping can be cast to. All
+// fields are little-endian and naturally aligned, and nothing is ever
+// parsed or byte-swapped, so statefile.cpp only builds for little-endian
+// hosts.
+//
+//     0     StateHeader8080 (64 bytes)
+//     64    StateSection8080[sections] (32 bytes each)
+//     ...   sections, each at a multiple of STATE_ALIGN
+//
+// A section may be stored run-length encoded instead (STATE_RLE), worth
+// it for RAM, whose video memory is mostly zero; those need LoadStateFile
+// to expand them. The header also carries the ROM's hashes, so a state is
+// never loaded under a different ROM, and the cycle count, for telling
+// checkpoints apart without reading further.
+//
+// A file is written under another name and renamed over the old one once
+// it is on disk, so a crash or a full disk never leaves a torn save.
+
+#define STATE_MAGIC         0x54533038  // "80ST"
+#define STATE_VERSION       1
+#define STATE_ALIGN         64
+#define STATE_SECTIONS_MAX  16
+
+enum StateSectionId {
+    SECTION_CPU = 1,                    // StateCpu8080
+    SECTION_RAM,                        // RAM_END - RAM_START bytes from RAM_START
+    SECTION_CABINET,                    // StateCabinet8080
+};
+
+#define STATE_RLE           0x0001      // StateSection8080 flags
+
+struct StateHeader8080 {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t sections;                  // entries in the table after the header
+    uint32_t rom_crc32;
+    uint32_t flags;                     // none yet
+    uint8_t rom_sha1[20];
+    uint32_t reserved0;
+    uint64_t cycles;
+    uint64_t file_size;
+    uint64_t reserved1;
+};
+
+struct StateSection8080 {
+    uint32_t id;                        // StateSectionId
+    uint32_t flags;                     // STATE_RLE
+    uint64_t offset;                    // from the start of the file
+    uint64_t size;                      // as stored
+    uint64_t raw_size;                  // once expanded
+};
+
+// The cpu, registers in the order an 8080 manual lists them. flags is
+// the ConditionCodes byte as PUSH PSW would store it.
+struct StateCpu8080 {
+    uint8_t a;
+    uint8_t flags;
+    uint8_t b;
+    uint8_t c;
+    uint8_t d;
+    uint8_t e;
+    uint8_t h;
+    uint8_t l;
+    uint16_t sp;
+    uint16_t pc;
+    uint8_t int_enable;
+    uint8_t halted;
+    uint8_t reserved[2];
+    uint64_t cycles;
+    uint64_t instructions;
+    uint64_t interrupts;
+};
+
+// Cabinet8080 without the pointer
+struct StateCabinet8080 {
+    uint8_t port1;
+    uint8_t port2;
+    uint8_t shift_offset;
+    uint8_t port3;
+    uint8_t port5;
+    uint8_t reserved;
+    uint16_t shift;
+};
+
+struct RomHash8080 {
+    uint32_t crc32;
+    uint8_t sha1[20];
+};
+
+// A state file mapped read-only.
+struct StateFile8080 {
+    const uint8_t* base;
+    size_t size;
+    const StateHeader8080* header;
+    const StateSection8080* sections;
+};
+
+void HashRom(const uint8_t* memory, RomHash8080* hash);
+int WriteStateFile(const char* filename, const State8080* state, const RomHash8080* rom, int compress);
+int OpenStateFile(const char* filename, StateFile8080* file);
+const StateSection8080* FindSection(const StateFile8080* file, uint32_t id);
+const void* SectionData(const StateFile8080* file, uint32_t id);
+int ReadSection(const StateFile8080* file, uint32_t id, void* out, size_t size);
+int LoadStateFile(const StateFile8080* file, State8080* state, const RomHash8080* rom);
+void CloseStateFile(StateFile8080* file);
+
+#endif
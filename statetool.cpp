@@ -0,0 +1,217 @@
+/*
+Shows and compares save states written by "invaders -w" (see statefile.h).
+
+    g++ -O2 -DPRINTOPS=0 statetool.cpp statefile.cpp romset.cpp machine.cpp 8080cpu.cpp disassembler.cpp -o statetool
+
+usage: statetool info file...
+       statetool diff a b
+
+info prints the header, the section table and the machine in each file.
+diff prints the registers, flags, ports and RAM ranges that differ, and
+exits 1 if anything does, like cmp. The instruction and interrupt counts
+are shown too but don't count: they measure work done, which starts over
+when a run resumes from a state (see LoadStateFile).
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "functions.h"
+#include "i8080.h"
+#include "machine.h"
+#include "statefile.h"
+
+#define RAM_BYTES       (RAM_END - RAM_START)
+#define MAX_RANGES      32
+
+// everything a file holds, expanded
+struct Loaded {
+    const StateHeader8080* header;
+    StateCpu8080 cpu;
+    StateCabinet8080 cabinet;
+    uint8_t ram[RAM_BYTES];
+};
+
+static const char* SectionName(uint32_t id)
+{
+    switch (id)
+    {
+        case SECTION_CPU: return "cpu";
+        case SECTION_RAM: return "ram";
+        case SECTION_CABINET: return "cabinet";
+    }
+    return "unknown";
+}
+
+static void FlagString(uint8_t flags, char* out)
+{
+    const char* names = "SZ-A-P-C";
+    for (int i = 0; i < 8; i++)
+        out[i] = (flags & (0x80 >> i)) && names[i] != '-' ? names[i] : '.';
+    out[8] = 0;
+}
+
+static int Load(const char* filename, StateFile8080* file, Loaded* loaded)
+{
+    int status = OpenStateFile(filename, file);
+    if (status == STATUS_OK)
+    {
+        loaded->header = file->header;
+        status = ReadSection(file, SECTION_CPU, &loaded->cpu, sizeof(loaded->cpu));
+    }
+    if (status == STATUS_OK)
+        status = ReadSection(file, SECTION_RAM, loaded->ram, sizeof(loaded->ram));
+    if (status == STATUS_OK)
+        status = ReadSection(file, SECTION_CABINET, &loaded->cabinet, sizeof(loaded->cabinet));
+    if (status != STATUS_OK)
+    {
+        printf("error: %s: %s\n", filename, StatusString8080(status));
+        CloseStateFile(file);
+    }
+    return status;
+}
+
+static void Info(const char* filename, const StateFile8080* file, const Loaded* loaded)
+{
+    const StateHeader8080* header = file->header;
+    printf("%s: version %d, %zu bytes, %llu cycles\n", filename, header->version, file->size,
+           (unsigned long long) header->cycles);
+    printf("  rom crc32 %08x sha1 ", header->rom_crc32);
+    for (int i = 0; i < 20; i++)
+        printf("%02x", header->rom_sha1[i]);
+    printf("\n");
+    for (int i = 0; i < header->sections; i++)
+    {
+        const StateSection8080* section = &file->sections[i];
+        printf("  %-8s at %6llu, %5llu bytes%s", SectionName(section->id), (unsigned long long) section->offset,
+               (unsigned long long) section->size, section->flags & STATE_RLE ? " rle" : "");
+        if (section->size != section->raw_size)
+            printf(" of %llu", (unsigned long long) section->raw_size);
+        printf("\n");
+    }
+
+    const StateCpu8080* cpu = &loaded->cpu;
+    char flags[9];
+    FlagString(cpu->flags, flags);
+    printf("  a %02x  bc %02x%02x  de %02x%02x  hl %02x%02x  sp %04x  pc %04x  flags %s  ei %d  halted %d\n",
+           cpu->a, cpu->b, cpu->c, cpu->d, cpu->e, cpu->h, cpu->l, cpu->sp, cpu->pc, flags, cpu->int_enable,
+           cpu->halted);
+    printf("  %llu instructions, %llu interrupts\n", (unsigned long long) cpu->instructions,
+           (unsigned long long) cpu->interrupts);
+    const StateCabinet8080* cabinet = &loaded->cabinet;
+    printf("  port1 %02x  port2 %02x  port3 %02x  port5 %02x  shift %04x offset %d\n", cabinet->port1,
+           cabinet->port2, cabinet->port3, cabinet->port5, cabinet->shift, cabinet->shift_offset);
+}
+
+static int DiffField(const char* name, unsigned long long a, unsigned long long b, int width)
+{
+    if (a == b)
+        return 0;
+    printf("%-14s %0*llx %0*llx\n", name, width, a, width, b);
+    return 1;
+}
+
+// returns the number of bytes that differ
+static int DiffRam(const uint8_t* a, const uint8_t* b)
+{
+    int bytes = 0, ranges = 0;
+    for (int i = 0; i < RAM_BYTES; )
+    {
+        if (a[i] == b[i])
+        {
+            i++;
+            continue;
+        }
+        int start = i;
+        while (i < RAM_BYTES && a[i] != b[i])
+            i++;
+        bytes += i - start;
+        if (++ranges > MAX_RANGES)
+            continue;
+        uint16_t first = RAM_START + start, last = RAM_START + i - 1;
+        printf("ram %04x-%04x  %4d bytes %s\n", first, last, i - start, first >= VRAM_START ? "video" : "work");
+    }
+    if (ranges > MAX_RANGES)
+        printf("... %d more ranges\n", ranges - MAX_RANGES);
+    if (bytes > 0)
+        printf("%d bytes of RAM differ in %d ranges\n", bytes, ranges);
+    return bytes;
+}
+
+static int Diff(const Loaded* a, const Loaded* b)
+{
+    int differ = 0;
+    if (a->header->rom_crc32 != b->header->rom_crc32 ||
+        memcmp(a->header->rom_sha1, b->header->rom_sha1, sizeof(a->header->rom_sha1)) != 0)
+    {
+        printf("saved under different ROMs\n");
+        differ = 1;
+    }
+    differ |= DiffField("cycles", a->cpu.cycles, b->cpu.cycles, 1);
+    DiffField("instructions", a->cpu.instructions, b->cpu.instructions, 1);
+    DiffField("interrupts", a->cpu.interrupts, b->cpu.interrupts, 1);
+    differ |= DiffField("a", a->cpu.a, b->cpu.a, 2);
+    differ |= DiffField("b", a->cpu.b, b->cpu.b, 2);
+    differ |= DiffField("c", a->cpu.c, b->cpu.c, 2);
+    differ |= DiffField("d", a->cpu.d, b->cpu.d, 2);
+    differ |= DiffField("e", a->cpu.e, b->cpu.e, 2);
+    differ |= DiffField("h", a->cpu.h, b->cpu.h, 2);
+    differ |= DiffField("l", a->cpu.l, b->cpu.l, 2);
+    differ |= DiffField("sp", a->cpu.sp, b->cpu.sp, 4);
+    differ |= DiffField("pc", a->cpu.pc, b->cpu.pc, 4);
+    differ |= DiffField("int_enable", a->cpu.int_enable, b->cpu.int_enable, 1);
+    differ |= DiffField("halted", a->cpu.halted, b->cpu.halted, 1);
+    if (a->cpu.flags != b->cpu.flags)
+    {
+        char fa[9], fb[9];
+        FlagString(a->cpu.flags, fa);
+        FlagString(b->cpu.flags, fb);
+        printf("%-14s %s %s\n", "flags", fa, fb);
+        differ = 1;
+    }
+    differ |= DiffField("port1", a->cabinet.port1, b->cabinet.port1, 2);
+    differ |= DiffField("port2", a->cabinet.port2, b->cabinet.port2, 2);
+    differ |= DiffField("port3", a->cabinet.port3, b->cabinet.port3, 2);
+    differ |= DiffField("port5", a->cabinet.port5, b->cabinet.port5, 2);
+    differ |= DiffField("shift", a->cabinet.shift, b->cabinet.shift, 4);
+    differ |= DiffField("shift_offset", a->cabinet.shift_offset, b->cabinet.shift_offset, 1);
+    if (DiffRam(a->ram, b->ram) > 0)
+        differ = 1;
+    return differ;
+}
+
+int main(int argc, char** argv)
+{
+    int info = argc >= 3 && strcmp(argv[1], "info") == 0;
+    int diff = argc == 4 && strcmp(argv[1], "diff") == 0;
+    if (!info && !diff)
+    {
+        printf("usage: statetool info file...\n       statetool diff a b\n");
+        return 2;
+    }
+
+    static Loaded loaded[2];
+    StateFile8080 files[2];
+    if (info)
+    {
+        int failed = 0;
+        for (int i = 2; i < argc; i++)
+        {
+            if (Load(argv[i], &files[0], &loaded[0]) != STATUS_OK)
+            {
+                failed = 1;
+                continue;
+            }
+            Info(argv[i], &files[0], &loaded[0]);
+            CloseStateFile(&files[0]);
+        }
+        return failed ? 2 : 0;
+    }
+
+    if (Load(argv[2], &files[0], &loaded[0]) != STATUS_OK || Load(argv[3], &files[1], &loaded[1]) != STATUS_OK)
+        return 2;
+    int differ = Diff(&loaded[0], &loaded[1]);
+    CloseStateFile(&files[0]);
+    CloseStateFile(&files[1]);
+    return differ;
+}
@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "machine.h"
+#include "stats.h"
+
+// Takes the core's own counters from state.
+void CollectStats(Stats8080* stats, const State8080* state)
+{
+    stats->instructions = state->instructions;
+    stats->cycles = state->cycles;
+    stats->interrupts = state->interrupts;
+}
+
+void AddStats(Stats8080* total, const Stats8080* part)
+{
+    total->frames += part->frames;
+    total->instructions += part->instructions;
+    total->cycles += part->cycles;
+    total->interrupts += part->interrupts;
+    total->cpu_ns += part->cpu_ns;
+    total->render_ns += part->render_ns;
+    total->io_ns += part->io_ns;
+    total->paced_frames += part->paced_frames;
+    total->jitter_total_ns += part->jitter_total_ns;
+    if (part->jitter_max_ns > total->jitter_max_ns)
+        total->jitter_max_ns = part->jitter_max_ns;
+    total->overruns += part->overruns;
+    total->presented += part->presented;
+    total->latency_count += part->latency_count;
+    total->latency_total_ns += part->latency_total_ns;
+    if (part->latency_max_ns > total->latency_max_ns)
+        total->latency_max_ns = part->latency_max_ns;
+}
+
+// name goes in every line, to tell instances apart.
+void InitStatsReporter(StatsReporter8080* reporter, FILE* out, const char* name, uint64_t interval_ns)
+{
+    memset(reporter, 0, sizeof(*reporter));
+    reporter->out = out;
+    reporter->name = name;
+    reporter->interval_ns = interval_ns;
+    reporter->start_ns = reporter->last_ns = MonotonicNs();
+}
+
+// Writes s as a JSON string, quotes included.
+static void WriteJsonString(FILE* out, const char* s)
+{
+    fputc('"', out);
+    for (; *s != '\0'; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+            fprintf(out, "\\%c", c);
+        else if (c < 0x20)
+            fprintf(out, "\\u%04x", c);
+        else
+            fputc(c, out);
+    }
+    fputc('"', out);
+}
+
+static double PerFrame(uint64_t ns, uint64_t frames)
+{
+    return frames > 0 ? (double) ns / frames : 0.0;
+}
+
+/*
+Writes a line if the interval has passed since the last one, or anyway
+with force (say at exit, when something has happened since).
+
+returns 1 if a line was written
+*/
+int ReportStats(StatsReporter8080* reporter, const Stats8080* stats, int force)
+{
+    uint64_t now = MonotonicNs();
+    if (now - reporter->last_ns < reporter->interval_ns && !(force && stats->frames > reporter->last.frames))
+        return 0;
+
+    const Stats8080* last = &reporter->last;
+    double secs = (now - reporter->last_ns) / 1e9;
+    uint64_t frames = stats->frames - last->frames;
+    fprintf(reporter->out, "{\"name\":");
+    WriteJsonString(reporter->out, reporter->name);
+    fprintf(reporter->out,
+            ",\"wall_s\":%.2f,\"frames\":%llu,\"instructions\":%llu,\"cycles\":%llu,"
+            "\"interrupts\":%llu,\"fps\":%.1f,\"mips\":%.3f,\"emulated_mhz\":%.3f,"
+            "\"cpu_ns_per_frame\":%.0f,\"render_ns_per_frame\":%.0f,\"io_ns_per_frame\":%.0f",
+            (now - reporter->start_ns) / 1e9, (unsigned long long) stats->frames,
+            (unsigned long long) stats->instructions, (unsigned long long) stats->cycles,
+            (unsigned long long) stats->interrupts, frames / secs,
+            (stats->instructions - last->instructions) / secs / 1e6,
+            (stats->cycles - last->cycles) / secs / 1e6,
+            PerFrame(stats->cpu_ns - last->cpu_ns, frames),
+            PerFrame(stats->render_ns - last->render_ns, frames),
+            PerFrame(stats->io_ns - last->io_ns, frames));
+    if (stats->paced_frames > 0)
+        fprintf(reporter->out,
+                ",\"jitter_mean_ns\":%.0f,\"jitter_max_ns\":%llu,\"overruns\":%llu,\"presented\":%llu,"
+                "\"latency_mean_ns\":%.0f,\"latency_max_ns\":%llu",
+                PerFrame(stats->jitter_total_ns - last->jitter_total_ns,
+                         (stats->paced_frames - stats->overruns) - (last->paced_frames - last->overruns)),
+                (unsigned long long) stats->jitter_max_ns, (unsigned long long) stats->overruns,
+                (unsigned long long) stats->presented,
+                PerFrame(stats->latency_total_ns - last->latency_total_ns,
+                         stats->latency_count - last->latency_count),
+                (unsigned long long) stats->latency_max_ns);
+    fprintf(reporter->out, "}\n");
+    fflush(reporter->out);
+
+    reporter->last = *stats;
+    reporter->last_ns = now;
+    return 1;
+}
@@ -0,0 +1,82 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <cstdio>
+#include "functions.h"
+#include "machine.h"
+
+// Runtime counters for monitoring. The core counts instructions,
+// interrupts and cycles in State8080 itself; Stats8080 adds frames and the
+// host time spent running the cpu, rendering, and on I/O (sound, streams,
+// inputs), timed per frame by whoever drives the machine. Each instance
+// owns its counters and only its own thread writes them, so there are no
+// atomics anywhere; a batch is summed with AddStats when reported.
+//
+// Run in real time (realtime.h) there is the pacing too: how late the cpu
+// thread woke for each frame's deadline, how many frames overran it, and
+// how long an input took to show up in a presented frame. The cpu thread
+// and the presenter each count their own half in a Stats8080 of their own.
+//
+// A reporter writes one JSON object per line every interval, with the
+// totals and the rates over the interval:
+//
+//   {"name":"invaders","wall_s":2.00,"frames":120,"instructions":...,
+//    "cycles":...,"interrupts":...,"fps":60.0,"mips":0.55,"emulated_mhz":2.00,
+//    "cpu_ns_per_frame":...,"render_ns_per_frame":...,"io_ns_per_frame":...}
+//
+// and in real time, means over the interval and maximums since the start,
+// the jitter only over frames that met their deadline (an overrun has no
+// wakeup to be late for, it's counted on its own):
+//
+//    ...,"jitter_mean_ns":...,"jitter_max_ns":...,"overruns":...,
+//    "presented":...,"latency_mean_ns":...,"latency_max_ns":...}
+
+#define STATS_INTERVAL_NS   1000000000ull
+
+// the size of a cache line, so batches of them don't share lines
+struct alignas(64) Stats8080 {
+    uint64_t frames;
+    uint64_t instructions;          // these three copied from the state(s)
+    uint64_t cycles;
+    uint64_t interrupts;
+    uint64_t cpu_ns;
+    uint64_t render_ns;
+    uint64_t io_ns;
+    // real time only, the cpu thread's
+    uint64_t paced_frames;
+    uint64_t jitter_total_ns;       // over paced_frames - overruns
+    uint64_t jitter_max_ns;
+    uint64_t overruns;              // frames that finished after their deadline
+    // real time only, the presenter's: from pushing an input to first
+    // seeing a frame run with it
+    uint64_t presented;
+    uint64_t latency_count;
+    uint64_t latency_total_ns;
+    uint64_t latency_max_ns;
+};
+
+// Adds the time since *lap to *bucket and starts the next lap, one clock
+// read per call.
+static inline void Lap(uint64_t* bucket, uint64_t* lap)
+{
+    uint64_t now = MonotonicNs();
+    *bucket += now - *lap;
+    *lap = now;
+}
+
+struct StatsReporter8080 {
+    FILE* out;
+    const char* name;
+    uint64_t interval_ns;
+    uint64_t start_ns;
+    uint64_t last_ns;
+    Stats8080 last;
+};
+
+void CollectStats(Stats8080* stats, const State8080* state);
+void AddStats(Stats8080* total, const Stats8080* part);
+void InitStatsReporter(StatsReporter8080* reporter, FILE* out, const char* name, uint64_t interval_ns);
+int ReportStats(StatsReporter8080* reporter, const Stats8080* stats, int force);
+
+#endif